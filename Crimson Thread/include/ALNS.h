@@ -0,0 +1,38 @@
+#ifndef ALNS_H
+#define ALNS_H
+//----INCLUDES--------------------------------------------------------
+#include "Utils.h"
+#include "HostageStation.h"
+#include "include/GeneticAlgorithm.h"
+
+//----CONSTANTS------------------------------------------------------
+const int ALNS_ITERATIONS = 20000;
+const int ALNS_MAX_REMOVED = 40; // In precents, most of the planned stations one destroy step can take out
+const double ALNS_START_TEMPERATURE = 0.5; // In PValue, a plan this much worse is accepted with chance 1/e at first
+const double ALNS_COOLING_RATE = 0.9995; // Temperature multiplier per iteration
+const int ALNS_SEGMENT_LENGTH = 100; // Iterations between operator weight updates
+const double ALNS_REACTION_FACTOR = 0.1; // Weight of the last segment in the operator weights
+const double ALNS_STEP_PENALTY = 1e-4; // Per step, makes shorter routes win between plans with the same PValue
+const int ALNS_SHARE_INTERVAL = 200; // Iterations between checks for a better plan found by another engine
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Adaptive large neighbourhood search with simulated annealing acceptance. Destroys part of the plan
+// (random, worst or related stations) and repairs it with the insertion heuristics.
+// Takes the same options as the GA, counted in iterations instead of generations: progress is reported every
+// options.progressInterval iterations, maxStagnantGenerations is iterations without a better plan and the
+// search runs up to ALNS_ITERATIONS iterations (maxGenerations is not used).
+vector<vector<LocationID>> ALNSAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                         const vector<pair<LocationID, Point> > &importantPoints,
+                                         int numOfUnits, HostageStation **hostageStations,
+                                         const GAOptions &options);
+
+// Run the GA and the ALNS on separate threads sharing the best plan through options.bestSoFar (or a local one).
+// Both stop as soon as either reaches the target or the upper bound, otherwise each runs its own course.
+// options.stats gets the counters of the GA, the earlier of the two times to target and the engine that offered
+// the best plan.
+vector<vector<LocationID>> PortfolioAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                              const vector<pair<LocationID, Point> > &importantPoints,
+                                              int numOfUnits, HostageStation **hostageStations,
+                                              const GAOptions &options);
+
+#endif //ALNS_H
@@ -9,6 +9,7 @@
 #include <queue>
 #include "Utils.h"
 #include "include/ThreadPool.h"
+#include "include/CancellationToken.h"
 
 //----NAMESPACES------------------------------------------------------
 using std::abs;
@@ -18,8 +19,13 @@ using std::string;
 using std::vector;
 using std::queue;
 
+//----CONSTANTS------------------------------------------------------
+const int SEARCH_CANCEL_POLL_INTERVAL = 1024; // Points the search expands between two polls of its token
+
 //----FUNCTION DECLARATIONS-------------------------------------
+// A cancelled search stops within SEARCH_CANCEL_POLL_INTERVAL points and adds no paths to the map
 void BFS(char **grid, LocationID startID, Point start, vector<pair<LocationID, Point>> importantPoints,
-         map<PathKey, vector<Point> > &pathsBetweenStations, mutex &pathMapMutex);
+         map<PathKey, vector<Point> > &pathsBetweenStations, mutex &pathMapMutex,
+         const CancellationToken &cancel = CancellationToken());
 
 #endif //BFS_H
@@ -0,0 +1,66 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+//----INCLUDES--------------------------------------------------------
+#include "Utils.h"
+#include "HostageStation.h"
+#include "include/ThreadPool.h"
+
+//----CONSTANTS------------------------------------------------------
+const int BENCHMARK_PLANS = 1024; // Different plans the fitness tasks go over
+const int BENCHMARK_BATCH_SIZE = 400; // Tasks per batch, one batch is like one generation of POPULATION_SIZE
+const int BENCHMARK_BATCHES = 500; // Batches per measurement
+const int BENCHMARK_REPEATS = 3; // Each measurement is repeated and the fastest one is kept
+const int BENCHMARK_GA_GENERATIONS = 500; // Generations of the GA runs that compare the parallel region to the pool
+const int BENCHMARK_BULK_TASKS = 20000; // Low priority fitness tasks that load the pool in the priority benchmark
+const int BENCHMARK_PROBES = 200; // Small tasks sent while the pool is loaded, to measure how long they wait
+const int BENCHMARK_PROBE_INTERVAL = 100; // Microseconds between two probes
+const int BENCHMARK_PRODUCERS = 8; // Threads outside the pool that enqueue at the same time in the queue benchmark
+const int BENCHMARK_PRODUCER_ROUNDS = 500; // Rounds of each producer, a round waits for its own tasks
+const int BENCHMARK_PRODUCER_BURST = 64; // Tasks per round, all the producers' rounds fit in POOL_RING_CAPACITY
+const int BENCHMARK_TARGET_RUNS = 5; // Runs per row of the time-to-target table, the searches are random
+const int BENCHMARK_TARGET_SECONDS = 10; // A time-to-target run that doesn't reach the target stops after this
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Run all the thread pool benchmarks on the scenario and print the results, targetFitness is the PValue the
+// time-to-target table aims for (-1 aims for what a full GA run finds)
+void RunBenchmarks(char **grid, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                   const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                   HostageStation **hostageStations, double targetFitness = -1);
+
+// Time batches of empty tasks and of per-plan fitness tasks (enqueue one task per plan, then WaitAll)
+// on the shared queue, the work stealing and the lock-free schedulers, one Enqueue per task and with EnqueueBulk
+void BenchmarkSchedulers(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                         const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                         unsigned int numOfThreads);
+
+// Let BENCHMARK_PRODUCERS threads enqueue empty tasks at once into the locked queue and into the lock-free ring,
+// and print the throughput, how long the Enqueue calls took and how long the tasks waited for a thread
+void BenchmarkQueueBackends(unsigned int numOfThreads);
+
+// Time batches of ParallelFor steps on the pool and on a persistent ParallelRegion, then time GA generations
+// with and without the region to see how much of the per-generation overhead it removes
+void BenchmarkParallelRegion(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                             const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                             const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                             unsigned int numOfThreads);
+
+// Load a pool with low priority fitness tasks and send small probe tasks meanwhile, once as low priority and
+// once as high priority, and print how long the probes and the bulk tasks waited in the queues
+void BenchmarkPriorities(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                         const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                         unsigned int numOfThreads);
+
+// Run the GA with and without the neighbour list mutations, the ALNS and the portfolio to targetFitness (or, if
+// it is negative, to the PValue of a full reference GA run). Print how often and how fast each got there, how many
+// GA mutations were accepted and which engine offered the best plan of the portfolio runs.
+void BenchmarkTimeToTarget(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                           const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                           HostageStation **hostageStations, unsigned int numOfThreads, double targetFitness);
+
+// Time the BFS between all the important points and a GA run on pools of 1, 2, 4, ... threads up to maxThreads,
+// with the threads floating, pinned to a core each and pinned to one logical core per physical core
+void BenchmarkScaling(char **grid, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                      const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                      HostageStation **hostageStations, unsigned int maxThreads);
+
+#endif //BENCHMARK_H
@@ -0,0 +1,63 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Lets one thread ask running work to stop. Copies of a token share its state, and the work polls IsCancelled
+// where it can stop cleanly, so nothing is cut off in the middle. A token made by Create can also have a
+// deadline and a parent, it counts as cancelled once the deadline passed or the parent was cancelled.
+// A default token is never cancelled and costs a null check to poll.
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CancellationToken() = default;
+
+    // New token that can be cancelled, with an optional deadline and parent
+    static CancellationToken Create(Clock::time_point deadline = Clock::time_point::max(),
+                                    const CancellationToken &parent = CancellationToken()) {
+        CancellationToken token;
+        token.state_ = std::make_shared<State>();
+        token.state_->deadline = deadline;
+        token.state_->parent = parent.state_;
+        return token;
+    }
+
+    // Ask the work that polls this token, and the tokens made with it as their parent, to stop
+    void Cancel() const {
+        if (state_ != nullptr) {
+            state_->cancelled.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // One relaxed load per token in the chain, plus a clock read for the ones that have a deadline
+    bool IsCancelled() const {
+        for (State *state = state_.get(); state != nullptr; state = state->parent.get()) {
+            if (state->cancelled.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            if (state->deadline != Clock::time_point::max() && Clock::now() >= state->deadline) {
+                // Remember it, so the next polls skip the clock
+                state->cancelled.store(true, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // False for a default token, which can never be cancelled
+    bool CanBeCancelled() const { return state_ != nullptr; }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        Clock::time_point deadline;
+        std::shared_ptr<State> parent;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+#endif //CANCELLATION_TOKEN_H
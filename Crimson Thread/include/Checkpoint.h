@@ -0,0 +1,70 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Utils.h"
+
+//----CONSTANTS------------------------------------------------------
+const uint32_t CHECKPOINT_MAGIC = 0x4B435443; // "CTCK" in the file
+const uint32_t CHECKPOINT_VERSION = 1; // Bump when the layout changes, older files are refused
+const uint32_t CHECKPOINT_MAX_COUNT = 1 << 20; // Biggest vector a checkpoint can hold, guards against broken files
+
+//----STRUCT------------------------------------------------------
+// Everything needed to continue a single population GA run from the generation it was saved at
+struct GACheckpoint {
+    uint64_t scenarioHash = 0; // Fingerprint of the stations and paths the run was planning for
+    int generation = 0; // Generations already done
+    int numOfUnits = 0;
+    int stepBudget = 0;
+    int stagnantGenerations = 0;
+    double lastBestFitness = -1;
+    vector<vector<vector<LocationID> > > population; // Unit paths of every chromosome
+    vector<double> fitness; // Fitness of every chromosome
+    vector<char> isValid; // If every chromosome meets the constraints
+    vector<double> operatorQuality; // Mutation operator selection state, indexed by MutationOperator
+    vector<double> operatorProbability;
+    std::string randomState; // Engine of the thread that runs the generations, in the std::mt19937 text form
+    vector<vector<LocationID> > bestPlan; // Best plan found so far
+    double bestFitness = -1;
+};
+
+//----CLASS------------------------------------------------------
+// Writes checkpoints from its own thread, so the GA only pays for copying its state.
+// If the GA hands checkpoints over faster than the disk takes them, only the newest waiting one is written.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const std::string &path);
+
+    // Writes the checkpoint still waiting, if any, before returning
+    ~CheckpointWriter();
+
+    // Queue the checkpoint to be written, replacing the one waiting if it wasn't written yet
+    void Submit(std::unique_ptr<GACheckpoint> checkpoint);
+
+    // Number of checkpoints written so far
+    int GetWrittenCount() const;
+
+private:
+    void Run();
+
+    std::string path_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unique_ptr<GACheckpoint> pending_; // Guarded by mutex_
+    bool stop_ = false; // Guarded by mutex_
+    std::atomic<int> writtenCount_{0};
+};
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Write the checkpoint to a temporary file and move it over the path, so a crash never leaves half a checkpoint
+bool SaveCheckpoint(const GACheckpoint &checkpoint, const std::string &path);
+
+// Read a checkpoint written by SaveCheckpoint, return false if the file is missing or broken
+bool LoadCheckpoint(GACheckpoint &checkpoint, const std::string &path);
+
+#endif //CHECKPOINT_H
@@ -0,0 +1,50 @@
+#ifndef CONSTRUCTION_H
+#define CONSTRUCTION_H
+//----INCLUDES--------------------------------------------------------
+#include <random>
+#include "Utils.h"
+#include "HostageStation.h"
+#include "include/RouteOptimizer.h"
+
+//----CONSTANTS------------------------------------------------------
+const int REGRET_K = 3; // Number of best units the regret insertion compares for each station
+const int RANDOM_CONSTRUCTION_CANDIDATES = 3; // Randomized constructions pick one of this many best insertions
+
+//----TYPES------------------------------------------------------
+enum InsertionRule {
+    CHEAPEST_INSERTION, // Station with the most PValue per added step first
+    REGRET_INSERTION // Station that loses the most by not going to its best unit first
+};
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Keep inserting unused stations into the plan at their cheapest position until none fits the step budget.
+// Each path must start with the entrance. numOfCandidates = 1 always takes the best insertion, more picks
+// randomly between that many best ones.
+void CompletePlan(vector<vector<LocationID> > &plan, const DistanceMatrix &distances,
+                  const vector<pair<LocationID, Point> > &importantPoints, HostageStation **hostageStations,
+                  int stepBudget, InsertionRule rule, int numOfCandidates, std::mt19937 &rng);
+
+// Build a plan from empty routes using the insertion rule
+vector<vector<LocationID> > ConstructPlan(const DistanceMatrix &distances,
+                                          const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                          HostageStation **hostageStations, int stepBudget, InsertionRule rule,
+                                          int numOfCandidates, std::mt19937 &rng);
+
+// Fit an old plan to the current stations and budget: drop stations that are gone or repeated, cut the least
+// PValue per step stations of routes over the budget, then fill the free budget with cheapest insertion.
+// Extra units are dropped and missing ones start empty.
+vector<vector<LocationID> > RepairPlan(const vector<vector<LocationID> > &plan, const DistanceMatrix &distances,
+                                       const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                       HostageStation **hostageStations, int stepBudget);
+
+// Plan in well under a millisecond without the GA: both insertion rules, routes ordered and refilled, best kept
+vector<vector<LocationID> > FastPlan(const DistanceMatrix &distances,
+                                     const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                     HostageStation **hostageStations, int stepBudget);
+
+// Same, building the distance matrix from the BFS paths first
+vector<vector<LocationID> > FastPlan(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                     const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                     HostageStation **hostageStations, int stepBudget);
+
+#endif //CONSTRUCTION_H
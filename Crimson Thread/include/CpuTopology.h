@@ -0,0 +1,15 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+//----INCLUDES--------------------------------------------------------
+#include <thread>
+#include <vector>
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Logical cores this process may run on, in increasing order. skipSmtSiblings keeps only the first logical core
+// of every physical core, so threads pinned to the list never share a core. Empty if the OS can't tell.
+std::vector<int> GetUsableCores(bool skipSmtSiblings);
+
+// Pin the thread to one logical core, returns false if the OS refused or doesn't support pinning
+bool PinThreadToCore(std::thread &thread, int core);
+
+#endif //CPU_TOPOLOGY_H
@@ -0,0 +1,66 @@
+#ifndef EVENT_COUNT_H
+#define EVENT_COUNT_H
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+//----CLASS------------------------------------------------------
+// Eventcount: lets threads sleep until a lock-free structure changes, without a lock on the fast paths.
+// A waiter calls PrepareWait, checks its condition again, and then either CancelWait or Wait with the key.
+// A notifier changes the structure and calls Notify, which only takes the mutex when someone is waiting.
+// A Notify that comes after PrepareWait always bumps the epoch, so the Wait of that key returns right away.
+class EventCount {
+public:
+    // Announce the wait, the key tells Wait which notifications it already saw
+    uint32_t PrepareWait() {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    // The condition was met after PrepareWait, don't wait
+    void CancelWait() {
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // Sleep until a Notify after the PrepareWait that gave the key
+    void Wait(uint32_t key) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this, key]() {
+                return epoch_.load(std::memory_order_relaxed) != key;
+            });
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // Wake count waiting threads, call it after the change the waiters look for
+    void Notify(int count) {
+        // Pairs with the seq_cst add of PrepareWait, either the waiter sees the change or we see the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int waiters = waiters_.load(std::memory_order_seq_cst);
+        if (waiters == 0) {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            epoch_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (count >= waiters) {
+            cv_.notify_all();
+        } else {
+            for (int i = 0; i < count; ++i) {
+                cv_.notify_one();
+            }
+        }
+    }
+
+private:
+    std::atomic<int> waiters_{0}; // Threads between PrepareWait and the end of Wait or CancelWait
+    std::atomic<uint32_t> epoch_{0}; // Bumped by every Notify that found a waiter
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+#endif //EVENT_COUNT_H
@@ -0,0 +1,42 @@
+#ifndef FITNESS_CACHE_H
+#define FITNESS_CACHE_H
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+//----CONSTANTS------------------------------------------------------
+const int FITNESS_CACHE_SIZE_BITS = 16; // The cache holds 2^16 entries (1 MB)
+const int FITNESS_CACHE_PROBES = 8; // Slots checked for a key before an old entry is overwritten
+
+//----CLASS------------------------------------------------------
+// Fixed size lock-free hash table from a chromosome hash to its fitness.
+// Any number of threads can look up and insert at the same time, when the probe window of a key is full
+// an old entry is overwritten, so the memory never grows.
+class FitnessCache {
+public:
+    explicit FitnessCache(int sizeBits = FITNESS_CACHE_SIZE_BITS);
+
+    // Get the fitness stored for the key, return if it was found
+    bool Lookup(uint64_t key, double &fitness) const;
+
+    // Store the fitness of the key, skipped if another thread is writing the same slot
+    void Insert(uint64_t key, double fitness);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key{EMPTY_KEY};
+        std::atomic<uint64_t> fitnessBits{0};
+    };
+
+    static const uint64_t EMPTY_KEY = 0;
+    static const uint64_t BUSY_KEY = 1; // A writer owns the slot, readers treat it as a miss
+
+    // Keys can't collide with the reserved values
+    static uint64_t FixKey(uint64_t key) { return key <= BUSY_KEY ? key + 2 : key; }
+
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t mask_;
+};
+
+#endif //FITNESS_CACHE_H
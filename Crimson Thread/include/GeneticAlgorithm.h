@@ -1,8 +1,16 @@
 #ifndef GENETIC_ALGORITHM_H
 #define GENETIC_ALGORITHM_H
 //----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <functional>
+#include <string>
 #include "Utils.h"
 #include "HostageStation.h"
+#include "include/CancellationToken.h"
+#include "include/RouteOptimizer.h"
+#include "include/ThreadPool.h"
 
 //----CONSTANTS------------------------------------------------------
 const int UNIT_STEP_BUDGET = 180;
@@ -12,15 +20,168 @@ const int TOURNAMENT_SIZE = 5;
 const int CROSSOVER_RATE = 80; // In precents
 const int MUTATION_RATE = 02; // In precents
 const int NUM_OF_ELITS = 3; // Number of elit chromosomes
+const int MEMETIC_RATE = 5; // In precents, chance an offspring gets a local search (0 turns the memetic step off)
+const int MEMETIC_MAX_ITERATIONS = 8; // Max improving moves the local search makes on one offspring
+const bool ISLAND_MODE = false; // Run one independent population per pool thread instead of one shared population
+const int MIN_ISLAND_POPULATION = 60; // Smallest population an island gets, needs to be even
+const int MIGRATION_INTERVAL = 40; // Generations between elite exchanges of neighbour islands
+const int NUM_OF_MIGRANTS = 2; // Elites each island sends to its neighbour on every exchange
+const double PVALUE_EPSILON = 1e-9; // Tolerance when comparing PValue sums added in different orders
+const bool ADAPTIVE_MUTATION = true; // Pick the mutation operators by their past success instead of uniformly
+const bool NEIGHBOUR_MUTATION = true; // Use the neighbour list mutation operators, off to compare the GA without them
+const int MIN_OPERATOR_PROBABILITY = 10; // In precents, every operator keeps at least this chance to be picked
+const double OPERATOR_ADAPTATION_RATE = 0.2; // Weight of the last generation in the operator quality estimate
+const int CONSTRUCTED_POPULATION_RATE = 10; // In precents, part of generation 0 built by the insertion heuristics
+const int WARM_START_POPULATION_RATE = 50; // In precents, part of generation 0 built around the previous plan
+const int WARM_START_MAX_REMOVED = 3; // Most stations taken out of the previous plan to make one of its neighbours
+const int REPLAN_GENERATIONS = 300; // Most generations a replan runs
+const int REPLAN_STAGNANT_GENERATIONS = 40; // A replan stops after this many generations without a better plan
+const int CHECKPOINT_INTERVAL = 100; // Generations between checkpoints when a checkpoint path is set
+const int PARALLEL_SEARCH_GRAIN = 1024; // Chromosomes per chunk of the parallel fittest search, less run inline
+const bool PERSISTENT_REGION_MODE = true; // Keep the pool threads hot across the generations in a ParallelRegion
+
+//----TYPES------------------------------------------------------
+using StationSet = std::bitset<MAX_STATIONS>; // Bit s is set if the station with ID s is in the set
+
+enum MutationOperator {
+    ADD_STATION,
+    REMOVE_STATION,
+    SWAP_IN_UNIT,
+    SWAP_BETWEEN_UNITS,
+    ADD_NEIGHBOUR_STATION, // Insert an unused near neighbour right after a station of the route
+    SWAP_NEIGHBOUR_STATION, // Replace a station with one of its unused near neighbours
+    NUM_OF_MUTATION_OPERATORS
+};
+
+// Search that offered a plan to a BestPlanTracker
+enum PlanEngine {
+    GA_ENGINE,
+    ALNS_ENGINE,
+    NUM_OF_PLAN_ENGINES
+};
 
 //----STRUCT------------------------------------------------------
 struct Chromosome {
     vector<vector<LocationID> > unitPaths; // Outer vector size = num_units
     // Inner vector holds ordered station IDs for that unit
     vector<int> unitSteps; // Holds how much steps each unit takes in here current plan
+    StationSet usedStations; // Stations visited by any of the units, kept up to date by every operator
     double fitness = 0.0; // Stores the calculated fitness (total PValue)
     bool isValid = false; // Flag indicating if constraints are met
     bool needsFitnessEvaluation = true; // Flag indicating if we need to pass through fitness check
+    int lastMutation = -1; // MutationOperator applied since the last evaluation, -1 if none
+    double fitnessBeforeMutation = 0; // PValue right before lastMutation, to credit the operator
+};
+
+// How one mutation operator did during the run
+struct MutationOperatorStats {
+    long long applications = 0; // Times the operator was picked
+    long long changes = 0; // Times it changed the chromosome (the rest broke the budget or had nothing to work on)
+    long long improvements = 0; // Times the mutated chromosome got a higher fitness
+    long long accepted = 0; // Times the mutated chromosome stayed valid without losing fitness
+    double totalGain = 0; // PValue gained by all the improvements
+    double seconds = 0; // CPU time spent inside the operator
+    double probability = 0; // Chance of picking the operator at the end of the run
+
+    double SuccessRate() const {
+        return applications > 0 ? static_cast<double>(improvements) / applications : 0.0;
+    }
+
+    double AcceptanceRate() const {
+        return applications > 0 ? static_cast<double>(accepted) / applications : 0.0;
+    }
+};
+
+// Counters collected while the GA runs, used to see where the evaluation budget goes
+struct GAStats {
+    long long evaluations = 0; // Chromosomes that went through a fitness evaluation
+    long long invalidEvaluations = 0; // Evaluations spent on chromosomes that broke a constraint
+    long long cacheLookups = 0; // Chromosomes checked against the fitness cache
+    long long cacheHits = 0; // Chromosomes that took their fitness from the cache instead of an evaluation
+    MutationOperatorStats mutationOperators[NUM_OF_MUTATION_OPERATORS]; // Indexed by MutationOperator
+    double secondsToTarget = -1; // Seconds until the best plan first reached GAOptions::targetFitness, -1 if never
+    PlanEngine bestEngine = GA_ENGINE; // Engine that offered the best plan, the portfolio runs both
+
+    // Fraction of the evaluations that were wasted on invalid chromosomes
+    double InvalidEvaluationRate() const {
+        return evaluations > 0 ? static_cast<double>(invalidEvaluations) / evaluations : 0.0;
+    }
+
+    // Fraction of the fitness cache lookups that found the plan
+    double CacheHitRate() const {
+        return cacheLookups > 0 ? static_cast<double>(cacheHits) / cacheLookups : 0.0;
+    }
+
+    // Fraction of all the mutation attempts that were accepted, over every operator
+    double MutationAcceptanceRate() const {
+        long long applications = 0;
+        long long accepted = 0;
+        for (const MutationOperatorStats &operatorStats: mutationOperators) {
+            applications += operatorStats.applications;
+            accepted += operatorStats.accepted;
+        }
+        return applications > 0 ? static_cast<double>(accepted) / applications : 0.0;
+    }
+};
+
+// Snapshot of a running GA, passed to the progress callback
+struct GAProgress {
+    int generation = 0;
+    double bestFitness = -1; // Total PValue of the best plan so far
+    int generationsWithoutImprovement = 0;
+    double elapsedSeconds = 0;
+    double upperBound = 0; // No plan can get a higher PValue than this
+    GAStats stats;
+    vector<vector<LocationID> > bestPlan; // Best plan so far, routes are not ordered yet
+};
+
+// Best plan found so far, safe to read from any thread while the GA is running
+class BestPlanTracker {
+public:
+    // Keep the plan if it is better than the current one, return if it was kept
+    bool Offer(const vector<vector<LocationID> > &plan, double fitness, PlanEngine engine = GA_ENGINE);
+
+    vector<vector<LocationID> > GetPlan() const;
+
+    double GetFitness() const;
+
+    // Engine that offered the kept plan
+    PlanEngine GetEngine() const;
+
+private:
+    mutable mutex mutex_; // Guards plan_ and engine_, fitness_ is atomic so the GA can check it without locking
+    vector<vector<LocationID> > plan_;
+    PlanEngine engine_ = GA_ENGINE;
+    std::atomic<double> fitness_{-1};
+};
+
+// Termination criteria and reporting for MainAlgorithm, the defaults run all GENERATIONS like before
+struct GAOptions {
+    int stepBudget = UNIT_STEP_BUDGET; // Steps each unit can take
+    int maxGenerations = GENERATIONS;
+    // Wall-clock time the GA must finish by
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    int maxStagnantGenerations = 0; // Stop after this many generations without a better plan, 0 never stops
+    double targetFitness = -1; // Stop as soon as a plan reaches this PValue, -1 ignores
+    bool stopAtUpperBound = true; // Stop as soon as a plan reaches the PValue upper bound, it is provably optimal
+    int progressInterval = 100; // Generations between progress reports
+    // Called with the progress every progressInterval generations, return false to stop the GA
+    std::function<bool(const GAProgress &)> onProgress;
+    BestPlanTracker *bestSoFar = nullptr; // Optional, receives every improvement while the GA runs
+    GAStats *stats = nullptr; // Optional, filled with the run counters when the GA finishes
+    // Save the GA state here every checkpointInterval generations and when the run ends, empty saves nothing.
+    // Only the single population GA is saved, ISLAND_MODE runs ignore it.
+    std::string checkpointPath;
+    int checkpointInterval = CHECKPOINT_INTERVAL;
+    bool resume = false; // Continue from the checkpoint in checkpointPath, a new run starts if it can't be used
+    bool persistentRegion = PERSISTENT_REGION_MODE; // Run the per-generation parallel steps on a ParallelRegion
+    ThreadPool *pool = nullptr; // Pool to run on, nullptr uses ThreadPool::Shared()
+    CancellationToken cancel; // Polled every generation, a cancelled run returns the best plan so far
+    TaskPriority priority = LOW_PRIORITY; // Of the tasks the run gives the pool
+    bool neighbourMutation = NEIGHBOUR_MUTATION; // Let the mutation pick ADD/SWAP_NEIGHBOUR_STATION
+    // Step costs between the same important points, nullptr builds them from the paths. Lets runs on the same
+    // scenario, like the rows of a sweep, share one matrix.
+    const DistanceMatrix *distances = nullptr;
 };
 
 //----FUNCTION DECLARATIONS------------------------------------------
@@ -29,9 +190,34 @@ int GetPathCost(LocationID id1, LocationID id2, const map<PathKey, vector<Point>
 // Helper to get cost (length - 1), returns -1 or throws if path not found
 double SumPValue(vector<vector<LocationID> > plan, HostageStation **hostageStations);
 
+// Upper bound on the total PValue any plan can get, used to stop the GA early and to report the optimality gap
+double PValueUpperBound(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                        const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                        HostageStation **hostageStations, int stepBudget);
+
+// Same bound from a distance matrix that is already built
+double PValueUpperBound(const DistanceMatrix &distances, const vector<pair<LocationID, Point> > &importantPoints,
+                        int numOfUnits, HostageStation **hostageStations, int stepBudget);
+
 // Get the total PValue from the plan
 vector<vector<LocationID>> MainAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
                                           const vector<pair<LocationID, Point> > &importantPoints,
                                           int numOfUnits,
                                           HostageStation **hostageStations); //initialize chromosome population
+
+// Anytime version of the GA, stops on the first criterion in options that is met and returns the best plan so far
+vector<vector<LocationID>> MainAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                          const vector<pair<LocationID, Point> > &importantPoints,
+                                          int numOfUnits, HostageStation **hostageStations,
+                                          const GAOptions &options);
+
+// Plan again after a small change (station PValues, removed stations or a new options.stepBudget) starting from
+// the previous plan. The plan is repaired to fit the current stations and budget and half of generation 0 is
+// built around it, then a short search runs: at most REPLAN_GENERATIONS generations, stopping after
+// REPLAN_STAGNANT_GENERATIONS without a better plan unless options ask for less.
+vector<vector<LocationID>> ReplanAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                           const vector<pair<LocationID, Point> > &importantPoints,
+                                           int numOfUnits, HostageStation **hostageStations,
+                                           const vector<vector<LocationID> > &previousPlan,
+                                           const GAOptions &options);
 #endif //GENETIC_ALGORITHM_H
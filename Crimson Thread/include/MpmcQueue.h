@@ -0,0 +1,103 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+//----CLASS------------------------------------------------------
+// Bounded multi-producer multi-consumer queue of Dmitry Vyukov: a ring of cells, each with a sequence number that
+// tells whose turn the cell is. A producer claims a cell with one CAS on enqueue_pos_ and publishes the item with a
+// release store of the sequence, a consumer does the same on dequeue_pos_, so neither side takes a lock and the two
+// sides only meet on the cells. The capacity is rounded up to a power of two.
+// A producer that is preempted between its CAS and its store holds up the consumers at that cell, TryPop reports
+// the queue as empty until it resumes.
+template<typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        cells_ = new Cell[size];
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcQueue() {
+        delete[] cells_;
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    // Move item into the queue, returns false and leaves item alone if the queue is full
+    bool TryPush(T &item) {
+        Cell *cell;
+        size_t position = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[position & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                // The cell is free for this position, claim it
+                if (enqueue_pos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // The consumers didn't empty the cell of the last lap yet
+                return false;
+            } else {
+                position = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Move the oldest item out of the queue, returns false if the queue is empty
+    bool TryPop(T &item) {
+        Cell *cell;
+        size_t position = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[position & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeue_pos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // No producer published this position yet
+                return false;
+            } else {
+                position = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->item);
+
+        // Free the cell for the producers of the next lap
+        cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    Cell *cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0}; // Next position for a producer
+    alignas(64) std::atomic<size_t> dequeue_pos_{0}; // Next position for a consumer
+};
+
+#endif //MPMC_QUEUE_H
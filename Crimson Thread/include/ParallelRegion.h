@@ -0,0 +1,114 @@
+#ifndef PARALLEL_REGION_H
+#define PARALLEL_REGION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "include/ThreadPool.h"
+
+const int REGION_SPIN_MICROSECONDS = 200; // How long a team thread spins for the next step before it leaves
+const int REGION_MAX_PAUSES = 64; // Spin backoff doubles the pauses between checks up to this, then yields
+
+// Runs a whole run of short parallel steps, like the generations of the GA, on the pool threads and keeps them hot
+// between the steps. Each step bumps a step counter and hires pool threads that aren't in the team. A team
+// thread stays in its pool task after a step and spins for the next one. If no step comes within
+// REGION_SPIN_MICROSECONDS it goes back to the pool, where it sleeps or runs other work like any idle thread, and
+// the next step hires it again. So steps that come close together start without a wake up, and the region never
+// adds threads to the pool's.
+// A step ends when its chunks are done, not at a barrier of a fixed team, since a busy pool thread may join late
+// or not at all. The caller takes chunks too, so a step never waits for a thread to join.
+// A region made on a pool thread (a GA inside a sweep), or on a pool without threads, has no team, and its
+// steps go to pool.ParallelFor.
+class ParallelRegion {
+public:
+    // persistent = false always uses the pool, to compare the two. The team and the forwarded steps run at priority.
+    ParallelRegion(ThreadPool &pool, bool persistent = true, TaskPriority priority = LOW_PRIORITY);
+
+    // Wait for the team to go back to the pool
+    ~ParallelRegion();
+
+    ParallelRegion(const ParallelRegion &) = delete;
+    ParallelRegion &operator=(const ParallelRegion &) = delete;
+
+    // One step: call function(i) for every i in [begin, end), chunked like ThreadPool::ParallelFor, and return
+    // when all are done. Only the thread that made the region may call it.
+    template<typename Function>
+    void ParallelFor(int begin, int end, int grain, Function &&function) {
+        if (!persistent_) {
+            pool_.ParallelFor(begin, end, grain, std::forward<Function>(function), priority_);
+            return;
+        }
+        int count = end - begin;
+        if (count <= 0) {
+            return;
+        }
+        int chunk_size = grain > 0 ? grain : (std::max)(1, (count + chunks_per_step_ - 1) / chunks_per_step_);
+        RunStep((count + chunk_size - 1) / chunk_size, [&](int chunk) {
+            int first = begin + chunk * chunk_size;
+            int last = (std::min)(end, first + chunk_size);
+            for (int i = first; i < last; ++i) {
+                function(i);
+            }
+        });
+    }
+
+    bool IsPersistent() const { return persistent_; }
+
+    // Times a team thread gave up waiting and went back to the pool, tells if the spin time fits the gaps between
+    // the steps
+    long long GetLeaveCount() const { return leave_count_.load(std::memory_order_relaxed); }
+
+private:
+    // One published step. Team threads may still hold an old step after it ended, so steps live on the heap.
+    struct Step {
+        long long number = 0;
+        int num_chunks = 0;
+        const std::function<void(int)> *chunk = nullptr;
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+
+        // The caller sleeps on done_cv when the step outlasts its spin, the last chunk wakes it
+        std::mutex mutex;
+        std::condition_variable done_cv;
+    };
+
+    // Pool task of a team thread: take chunks of every step after seen_step, go back to the pool when no step comes
+    void TeamLoop(long long seen_step);
+
+    // Publish the step, hire missing team threads, run chunks and wait until all chunks are done: spin for
+    // spin_time_, then sleep until the thread with the last chunk wakes us
+    void RunStep(int num_chunks, const std::function<void(int)> &chunk);
+
+    // Take chunks of the step until none are left, whoever finishes the last chunk wakes the caller
+    static void TakeChunks(Step &step);
+
+    // Spin with backoff until ready() or the deadline, returns ready()
+    static bool SpinUntil(const std::function<bool()> &ready, std::chrono::steady_clock::time_point deadline);
+
+    ThreadPool &pool_;
+    TaskPriority priority_;
+    bool persistent_ = false;
+    int team_size_ = 0;
+    int chunks_per_step_ = 1;
+
+    // No spinning on a single core, the thread we wait for can't run while we spin
+    std::chrono::microseconds spin_time_{REGION_SPIN_MICROSECONDS};
+
+    // The current step. Team threads spin on step_number_ and then copy current_step_ under step_mutex_.
+    std::atomic<long long> step_number_{0};
+    std::mutex step_mutex_;
+    std::shared_ptr<Step> current_step_;
+
+    // Team threads in their task, or hired and not started yet
+    std::atomic<int> members_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<long long> leave_count_{0};
+
+    // The tasks of the team, so the destructor can wait for them
+    TaskGroup team_;
+};
+
+#endif //PARALLEL_REGION_H
@@ -0,0 +1,51 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+//----INCLUDES--------------------------------------------------------
+#include "Utils.h"
+#include "HostageStation.h"
+#include "include/GeneticAlgorithm.h"
+#include "include/ThreadPool.h"
+
+//----CONSTANTS------------------------------------------------------
+const int SWEEP_BUDGETS[] = {120, 150, 180, 210, 240}; // Unit step budgets the sweep tries
+const int SWEEP_UNIT_COUNTS[] = {3, 4, 5}; // Unit counts the sweep tries
+
+//----TYPES------------------------------------------------------
+enum PlannerType {
+    GA_PLANNER,
+    FAST_PLANNER, // Insertion heuristics only
+    ALNS_PLANNER,
+    PORTFOLIO_PLANNER // GA and ALNS at once
+};
+
+//----STRUCT------------------------------------------------------
+// One row of the sweep table
+struct SweepResult {
+    int stepBudget = 0;
+    int numOfUnits = 0;
+    double pValue = 0;
+    double upperBound = 0;
+    double seconds = 0; // Time the planner took for this configuration
+    vector<vector<LocationID> > plan;
+};
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Plan with the chosen engine, options.stepBudget sets the budget (the fast planner only reads the budget and
+// options.distances)
+vector<vector<LocationID> > RunPlanner(PlannerType planner, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                       const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                       HostageStation **hostageStations, const GAOptions &options);
+
+// Plan every (budget, unit count) pair on the thread pool at once, all sharing the same BFS paths and distances.
+// The results come back in the order budgets x unit counts. Cancelling cancel skips the runs that didn't start
+// and stops the running ones at their next generation, they keep the best plan they had.
+vector<SweepResult> RunBudgetSweep(PlannerType planner, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                   const vector<pair<LocationID, Point> > &importantPoints,
+                                   HostageStation **hostageStations, const vector<int> &stepBudgets,
+                                   const vector<int> &unitCounts, ThreadPool &pool,
+                                   const CancellationToken &cancel = CancellationToken());
+
+// Print the sweep results as a table
+void PrintSweepTable(const vector<SweepResult> &results, double totalSeconds);
+
+#endif //PLANNER_H
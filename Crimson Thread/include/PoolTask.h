@@ -0,0 +1,143 @@
+#ifndef POOL_TASK_H
+#define POOL_TASK_H
+//----INCLUDES--------------------------------------------------------
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//----CONSTANTS------------------------------------------------------
+const size_t POOL_TASK_BUFFER_SIZE = 64; // Callables up to this size are stored inside the task without allocating
+
+//----CLASS------------------------------------------------------
+// Move-only void() callable for the thread pool. Unlike std::function it never copies the callable,
+// and lambdas that capture up to POOL_TASK_BUFFER_SIZE bytes are stored in the task itself, so
+// scheduling them doesn't allocate. Bigger callables are moved to the heap.
+class PoolTask {
+public:
+    PoolTask() = default;
+
+    template<typename Function, typename = typename std::enable_if<
+            !std::is_same<typename std::decay<Function>::type, PoolTask>::value>::type>
+    PoolTask(Function &&function) {
+        using Stored = typename std::decay<Function>::type;
+        Construct<Stored>(std::forward<Function>(function), std::integral_constant<bool, FitsInBuffer<Stored>()>());
+    }
+
+    PoolTask(PoolTask &&other) noexcept {
+        MoveFrom(other);
+    }
+
+    PoolTask &operator=(PoolTask &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    PoolTask(const PoolTask &) = delete;
+    PoolTask &operator=(const PoolTask &) = delete;
+
+    ~PoolTask() {
+        Reset();
+    }
+
+    void operator()() {
+        operations_->invoke(buffer_);
+    }
+
+    explicit operator bool() const {
+        return operations_ != nullptr;
+    }
+
+    // Destroy the callable, the task becomes empty
+    void Reset() {
+        if (operations_ != nullptr) {
+            operations_->destroy(buffer_);
+            operations_ = nullptr;
+        }
+    }
+
+private:
+    // What the task needs to know about the stored callable type
+    struct Operations {
+        void (*invoke)(void *buffer);
+        void (*move)(void *from, void *to); // Move the callable to an empty buffer and destroy the old one
+        void (*destroy)(void *buffer);
+    };
+
+    template<typename Stored>
+    static constexpr bool FitsInBuffer() {
+        return sizeof(Stored) <= POOL_TASK_BUFFER_SIZE && alignof(Stored) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Stored>::value;
+    }
+
+    template<typename Stored>
+    struct InlineOperations {
+        static void Invoke(void *buffer) {
+            (*static_cast<Stored *>(buffer))();
+        }
+
+        static void Move(void *from, void *to) {
+            new(to) Stored(std::move(*static_cast<Stored *>(from)));
+            static_cast<Stored *>(from)->~Stored();
+        }
+
+        static void Destroy(void *buffer) {
+            static_cast<Stored *>(buffer)->~Stored();
+        }
+
+        static constexpr Operations operations = {Invoke, Move, Destroy};
+    };
+
+    template<typename Stored>
+    struct HeapOperations {
+        static void Invoke(void *buffer) {
+            (**static_cast<Stored **>(buffer))();
+        }
+
+        static void Move(void *from, void *to) {
+            *static_cast<Stored **>(to) = *static_cast<Stored **>(from);
+        }
+
+        static void Destroy(void *buffer) {
+            delete *static_cast<Stored **>(buffer);
+        }
+
+        static constexpr Operations operations = {Invoke, Move, Destroy};
+    };
+
+    // Small callable, keep it in the buffer
+    template<typename Stored, typename Function>
+    void Construct(Function &&function, std::true_type) {
+        new(buffer_) Stored(std::forward<Function>(function));
+        operations_ = &InlineOperations<Stored>::operations;
+    }
+
+    // Too big for the buffer, keep a pointer to it
+    template<typename Stored, typename Function>
+    void Construct(Function &&function, std::false_type) {
+        *reinterpret_cast<Stored **>(buffer_) = new Stored(std::forward<Function>(function));
+        operations_ = &HeapOperations<Stored>::operations;
+    }
+
+    void MoveFrom(PoolTask &other) {
+        if (other.operations_ != nullptr) {
+            other.operations_->move(other.buffer_, buffer_);
+            operations_ = other.operations_;
+            other.operations_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buffer_[POOL_TASK_BUFFER_SIZE];
+    const Operations *operations_ = nullptr;
+};
+
+template<typename Stored>
+constexpr PoolTask::Operations PoolTask::InlineOperations<Stored>::operations;
+
+template<typename Stored>
+constexpr PoolTask::Operations PoolTask::HeapOperations<Stored>::operations;
+
+#endif //POOL_TASK_H
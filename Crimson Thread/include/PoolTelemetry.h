@@ -0,0 +1,124 @@
+#ifndef POOL_TELEMETRY_H
+#define POOL_TELEMETRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+const int HISTOGRAM_SUB_BUCKET_BITS = 4; // 16 buckets per power of two, a value is off by at most 1/16 of itself
+const int HISTOGRAM_MAX_BITS = 40; // Values of 2^40 and up (about 18 minutes in nanoseconds) share the last bucket
+const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+const int HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+// Copy of a Histogram that can be merged and queried
+struct HistogramSnapshot {
+    std::vector<long long> counts = std::vector<long long>(HISTOGRAM_BUCKETS, 0);
+    long long total = 0;
+    long long sum = 0;
+    long long max = 0;
+
+    // Add the values of other to this one
+    void Merge(const HistogramSnapshot &other);
+
+    // Smallest value that fraction (0 to 1) of the values are at or below, within the bucket precision
+    long long Percentile(double fraction) const;
+
+    double Mean() const { return total > 0 ? static_cast<double>(sum) / total : 0; }
+};
+
+// Log-linear histogram in the style of HdrHistogram: values below HISTOGRAM_SUB_BUCKETS get a bucket each, every
+// power of two above that is split into HISTOGRAM_SUB_BUCKETS buckets, so the precision is relative to the value.
+// Only one thread may call Record, which is why it gets away with plain loads and stores of relaxed atomics instead
+// of read-modify-writes. Any thread can take a Snapshot, which may be a few values behind the recording thread.
+class Histogram {
+public:
+    Histogram() {
+        for (std::atomic<long long> &count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void Record(long long value) {
+        if (value < 0) {
+            value = 0;
+        }
+        std::atomic<long long> &count = counts_[BucketOf(static_cast<uint64_t>(value))];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot Snapshot() const;
+
+    // Highest value that lands in the bucket
+    static long long BucketLimit(int bucket);
+
+private:
+    static int BucketOf(uint64_t value) {
+        if (value < HISTOGRAM_SUB_BUCKETS) {
+            return static_cast<int>(value);
+        }
+        int exponent = HighestBit(value);
+        if (exponent >= HISTOGRAM_MAX_BITS) {
+            return HISTOGRAM_BUCKETS - 1;
+        }
+        int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+        return (shift + 1) * HISTOGRAM_SUB_BUCKETS + static_cast<int>(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+    }
+
+    // Index of the highest set bit, value must not be 0
+    static int HighestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<int>(index);
+#elif defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int index = 0;
+        while (value >>= 1) {
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    std::atomic<long long> counts_[HISTOGRAM_BUCKETS];
+    std::atomic<long long> sum_{0};
+    std::atomic<long long> max_{0};
+};
+
+// Counters of one pool thread
+struct WorkerTelemetry {
+    int core = -1; // Core the thread is pinned to, -1 if it isn't
+    long long tasks = 0; // Tasks run, including the ones run while waiting inside another task
+    long long steals = 0; // Tasks taken from the deque of another thread
+    double busy_milliseconds = 0; // Running tasks
+    double idle_milliseconds = 0; // Asleep with nothing to do, the rest of the time went to looking for tasks
+};
+
+// What a pool did since it was made, taken by ThreadPool::GetTelemetry
+struct PoolTelemetry {
+    double uptime_milliseconds = 0;
+    int queued_tasks = 0; // Enqueued and not started yet, at the time of the snapshot
+    int active_tasks = 0; // Enqueued and not finished yet, at the time of the snapshot
+    std::vector<int> shared_queue_depth; // Tasks in the shared queue of each priority, at the time of the snapshot
+    std::vector<WorkerTelemetry> workers;
+    std::vector<HistogramSnapshot> queue_wait; // Nanoseconds from enqueue to a thread taking the task, per priority
+    HistogramSnapshot run_time; // Nanoseconds from the start to the end of each task
+    HistogramSnapshot queue_depth; // Tasks still queued each time a thread took one
+};
+
+// Print the snapshot as a table of the threads and one of the histograms
+void PrintPoolTelemetry(const PoolTelemetry &telemetry, FILE *file);
+
+#endif //POOL_TELEMETRY_H
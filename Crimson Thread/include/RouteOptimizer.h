@@ -0,0 +1,72 @@
+#ifndef ROUTE_OPTIMIZER_H
+#define ROUTE_OPTIMIZER_H
+//----INCLUDES--------------------------------------------------------
+#include "Utils.h"
+#include "include/ThreadPool.h"
+
+//----CONSTANTS------------------------------------------------------
+const int HELD_KARP_MAX_STOPS = 16; // Above this the DP table (2^n * n) gets too big, use local search instead
+const int MAX_LOCAL_SEARCH_ROUNDS = 100; // Max passes of 2-opt/Or-opt over a path
+const int OR_OPT_MAX_SEGMENT = 3; // Longest chain of stations Or-opt will try to move
+const int NEIGHBOUR_LIST_SIZE = 5; // Nearest stations kept as candidates for each important point
+
+//----TYPES------------------------------------------------------
+// Nearest stations of each important point ordered by step cost, indexed like the distance matrix (ID + 1)
+using NeighbourLists = vector<vector<LocationID> >;
+
+//----STRUCT------------------------------------------------------
+// Flat table of the step cost between every two important points.
+// The entrance (-1) is stored at index 0 and station ID s at index s + 1.
+struct DistanceMatrix {
+    int size = 0;
+    vector<int> costs; // size * size, -1 marks an unknown path
+
+    // Get the step cost between two locations, -1 if there is no known path
+    int GetCost(LocationID id1, LocationID id2) const {
+        int i = id1 + 1;
+        int j = id2 + 1;
+        if (i < 0 || j < 0 || i >= size || j >= size) {
+            return -1;
+        }
+        return costs[i * size + j];
+    }
+};
+
+//----FUNCTION DECLARATIONS------------------------------------------
+// Build the distance matrix once from the BFS paths so lookups don't need the map
+DistanceMatrix BuildDistanceMatrix(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                   const vector<pair<LocationID, Point> > &importantPoints);
+
+// Keep the listSize closest reachable stations of every important point, the entrance is never a neighbour
+NeighbourLists BuildNeighbourLists(const DistanceMatrix &distances,
+                                   const vector<pair<LocationID, Point> > &importantPoints, int listSize);
+
+// Get the total steps of a path, -1 if one of the segments is unknown
+int PathDistance(const vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Order the path optimally using Held-Karp bitmask DP (only for up to HELD_KARP_MAX_STOPS stations)
+void OrderPathHeldKarp(vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Steps added by putting station right before path[position] (position == size appends it)
+int InsertionCost(const vector<LocationID> &path, int position, LocationID station, const DistanceMatrix &distances);
+
+// Steps saved by taking path[index] out of the path
+int RemovalGain(const vector<LocationID> &path, int index, const DistanceMatrix &distances);
+
+// Apply the first 2-opt move that shortens the path, return if the path was changed
+bool TryTwoOpt(vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Apply the first Or-opt move (moving a chain of stations) that shortens the path, return if the path was changed
+bool TryOrOpt(vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Improve the path order using 2-opt and Or-opt moves until no move helps
+void OrderPathLocalSearch(vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Order a single unit path, choosing the exact or the local search engine by its size
+void OrderPath(vector<LocationID> &path, const DistanceMatrix &distances);
+
+// Order the path of each of the units in parallel
+void FindBestPathInPlan(vector<vector<LocationID> > &fullPlan, const DistanceMatrix &distances, ThreadPool &pool,
+                        TaskPriority priority = LOW_PRIORITY);
+
+#endif //ROUTE_OPTIMIZER_H
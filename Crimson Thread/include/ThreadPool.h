@@ -1,49 +1,396 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 #include <atomic>
+#include "include/CancellationToken.h"
+#include "include/EventCount.h"
+#include "include/MpmcQueue.h"
+#include "include/PoolTask.h"
+#include "include/PoolTelemetry.h"
+#include "include/WorkStealingDeque.h"
+
+const size_t MAX_FREE_TASK_NODES = 1024; // Deque nodes each thread keeps for reuse
+const int PARALLEL_CHUNKS_PER_THREAD = 4; // Automatic chunking cuts a loop into this many chunks per thread
+const int HIGH_PRIORITY_BURST = 8; // High priority tasks a thread runs in a row before a waiting low one gets a turn
+const size_t POOL_RING_CAPACITY = 4096; // Tasks each lock-free queue holds, more go to the locked queue
+
+// Classes of tasks, the threads take the high priority tasks first
+enum TaskPriority {
+    HIGH_PRIORITY, // Latency sensitive work, like replanning and frame preparation
+    LOW_PRIORITY, // Throughput work, like the all-pairs BFS, sweeps and GA islands
+    NUM_OF_TASK_PRIORITIES
+};
+
+// How long the tasks of one priority class waited in the queues before a thread took them
+struct QueueWaitStats {
+    long long tasks = 0;
+    double mean_microseconds = 0;
+    double max_microseconds = 0;
+};
+
+// How the pool hands the tasks to its threads
+enum PoolScheduler {
+    SHARED_QUEUE_SCHEDULER, // One queue guarded by queue_mutex_ for all the threads
+    WORK_STEALING_SCHEDULER, // A deque per thread, idle threads steal from the others
+    LOCK_FREE_QUEUE_SCHEDULER // One bounded lock-free ring for all the threads, idle threads sleep on an eventcount
+};
+
+// How to build a pool, the defaults give a thread per core that the OS moves around freely
+struct PoolConfig {
+    unsigned int num_threads = 0; // 0 gives a thread per usable core, leaving out the reserved core
+    PoolScheduler scheduler = WORK_STEALING_SCHEDULER;
+    bool pin_threads = false; // Pin thread i to the i-th usable core, wrapping around when there are more threads
+    bool skip_smt_siblings = false; // Count and pin to one logical core per physical core
+    int reserved_core = -1; // Logical core left for the render/console thread, -1 reserves none
+    int telemetry_dump_milliseconds = 0; // Print the telemetry of the pool this often, 0 never does
+    std::string telemetry_file; // File the dumps are appended to, empty prints them to stderr
+};
 
 // Class that represents a simple thread pool
 class ThreadPool {
+    friend class TaskGroup;
+
 public:
     // Constructor to create a thread pool with given number of threads
-    ThreadPool(unsigned int num_threads = std::thread::hardware_concurrency());
+    ThreadPool(unsigned int num_threads = std::thread::hardware_concurrency(),
+               PoolScheduler scheduler = WORK_STEALING_SCHEDULER);
+
+    // Constructor to create a thread pool sized and pinned by config
+    explicit ThreadPool(const PoolConfig &config);
 
     // Destructor to stop the thread pool
     ~ThreadPool();
 
-    // Enqueue task for execution by the thread pool
-    void Enqueue(std::function<void()> task);
+    // Enqueue task for execution by the thread pool.
+    // With work stealing a low priority task enqueued by one of the pool threads goes to the deque of that thread,
+    // high priority tasks always go to the shared high priority queue, which the threads check first.
+    void Enqueue(PoolTask task, TaskPriority priority = LOW_PRIORITY);
+
+    // Enqueue one task per index in [begin, end) that calls function(index), taking the queue lock
+    // and waking the threads only once for all of them
+    void EnqueueBulk(int begin, int end, std::function<void(int)> function, TaskPriority priority = LOW_PRIORITY);
+
+    // Enqueue function and get a future for its result
+    template<typename Function>
+    auto Submit(Function &&function, TaskPriority priority = LOW_PRIORITY) -> std::future<decltype(function())> {
+        using Result = decltype(function());
+        std::packaged_task<Result()> task(std::forward<Function>(function));
+        std::future<Result> future = task.get_future();
+        Enqueue(std::move(task), priority);
+        return future;
+    }
 
-    // Wait for all the thread to finish running
+    // Wait for a future of Submit. On a pool thread the pending tasks run meanwhile, so a task can wait for the
+    // tasks it submitted without taking a thread away from them.
+    template<typename T>
+    void Wait(const std::future<T> &future) {
+        if (current_pool_ != this) {
+            future.wait();
+            return;
+        }
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!RunPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Wait for all the thread to finish running, must not be called from a task of this pool.
+    // This waits for the tasks of every user of the pool, use a TaskGroup to wait only for your own.
     void WaitAll();
+
+    // Call function(i) for every i in [begin, end) and return when all are done. The range is cut into chunks
+    // of grain indexes (0 picks the size by the thread count), the calling thread runs chunks too instead of
+    // blocking, and a range that fits in one chunk runs right here without touching the pool.
+    // Can be called from a task of this pool. The helper tasks get the given priority.
+    template<typename Function>
+    void ParallelFor(int begin, int end, int grain, Function &&function, TaskPriority priority = LOW_PRIORITY) {
+        int count = end - begin;
+        if (count <= 0) {
+            return;
+        }
+        int chunk_size = ChunkSize(count, grain);
+        RunChunks((count + chunk_size - 1) / chunk_size, [&](int chunk) {
+            int first = begin + chunk * chunk_size;
+            int last = (std::min)(end, first + chunk_size);
+            for (int i = first; i < last; ++i) {
+                function(i);
+            }
+        }, priority);
+    }
+
+    // Fold function(i) for every i in [begin, end) with combine, chunked like ParallelFor.
+    // combine must be associative, the chunks are combined in index order so the result doesn't depend on timing.
+    template<typename T, typename Function, typename Combine>
+    T ParallelReduce(int begin, int end, int grain, T identity, Function &&function, Combine &&combine,
+                     TaskPriority priority = LOW_PRIORITY) {
+        int count = end - begin;
+        if (count <= 0) {
+            return identity;
+        }
+        int chunk_size = ChunkSize(count, grain);
+        int num_chunks = (count + chunk_size - 1) / chunk_size;
+        std::vector<T> partial(num_chunks, identity);
+        RunChunks(num_chunks, [&](int chunk) {
+            int first = begin + chunk * chunk_size;
+            int last = (std::min)(end, first + chunk_size);
+            T result = identity;
+            for (int i = first; i < last; ++i) {
+                result = combine(result, function(i));
+            }
+            partial[chunk] = result;
+        }, priority);
+
+        T result = identity;
+        for (const T &chunk_result : partial) {
+            result = combine(result, chunk_result);
+        }
+        return result;
+    }
+
+    PoolScheduler GetScheduler() const { return scheduler_; }
+
+    unsigned int GetThreadCount() const { return static_cast<unsigned int>(threads_.size()); }
+
+    // True when called from a task running on one of the threads of this pool
+    bool IsPoolThread() const { return current_pool_ == this; }
+
+    // Queue wait of the tasks of one priority class since the pool was made
+    QueueWaitStats GetQueueWait(TaskPriority priority) const;
+
+    // Counters of every thread and the wait, run time and queue depth histograms since the pool was made.
+    // The threads keep recording meanwhile, so the parts of the snapshot may be a few tasks apart.
+    PoolTelemetry GetTelemetry() const;
+
+    // Core the thread with the given index is pinned to, -1 if it isn't pinned
+    int GetThreadCore(unsigned int index) const {
+        return index < thread_cores_.size() ? thread_cores_[index] : -1;
+    }
+
+    // The pool of the whole process, made on first use with the config of ConfigureShared (a thread per core
+    // by default). BFS, the GA and the sweeps all run on it instead of each making its own threads.
+    static ThreadPool &Shared();
+
+    // Set the config of the shared pool, returns false if the shared pool was already made.
+    // Call it at the start of the program, before any thread can use Shared().
+    static bool ConfigureShared(const PoolConfig &config);
+
 private:
+    // Deque entry of the work stealing scheduler, the threads reuse them instead of allocating one per task
+    struct TaskNode {
+        PoolTask task;
+        int64_t enqueue_time = 0; // Of Now(), to measure the queue wait
+    };
+
+    // Entry of the shared queues
+    struct QueuedTask {
+        PoolTask task;
+        int64_t enqueue_time;
+    };
+
+    // Telemetry of one thread, written only by that thread so it needs no read-modify-writes
+    struct WorkerCounters {
+        std::atomic<long long> tasks{0};
+        std::atomic<long long> steals{0};
+        std::atomic<long long> busy_ns{0};
+        std::atomic<long long> idle_ns{0};
+        Histogram queue_wait[NUM_OF_TASK_PRIORITIES];
+        Histogram run_time;
+        Histogram queue_depth;
+    };
+
+    // Create the threads, pinning them to thread_cores_ if it is set
+    void Start(unsigned int num_threads);
+
+    // Main loop of the thread with the given index
+    void WorkerLoop(unsigned int index);
+
+    // Find the next task for the thread: high priority tasks first (but see HIGH_PRIORITY_BURST), then the
+    // low priority ones
+    bool TryGetTask(unsigned int index, PoolTask &task, unsigned int &random_state);
+
+    // Find a low priority task: the own deque first, then the shared queue, then the other deques
+    bool TryGetLowPriorityTask(unsigned int index, PoolTask &task, unsigned int &random_state);
+
+    // Take the oldest task of the shared queues of the priority, false if they are empty
+    bool TakeSharedTask(TaskPriority priority, PoolTask &task);
+
+    // Count a task of the priority that was enqueued at enqueue_time as taken by the calling pool thread
+    void CountTakenTask(TaskPriority priority, int64_t enqueue_time);
+
+    // Add one to a counter that only the calling thread writes
+    static void Increment(std::atomic<long long> &counter, long long amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // Steady clock in nanoseconds
+    static int64_t Now();
+
+    // Run the task just taken by the pool thread and count it as done, returns how long it ran in nanoseconds
+    int64_t RunTask(PoolTask &task);
+
+    // Print GetTelemetry to file every interval until the pool stops, and once more then
+    void DumpLoop(std::chrono::milliseconds interval, FILE *file);
+
+    // Pool threads only, run one task that is waiting for a thread. Returns false if none was found.
+    bool RunPendingTask();
+
+    // Get a node from the free nodes of the calling pool thread
+    TaskNode *AllocateNode(PoolTask &&task, int64_t enqueue_time);
+
+    // Take the task out of the node and keep the node for reuse by the calling pool thread
+    void ReleaseNode(TaskNode *node, PoolTask &task);
+
+    // Wake sleeping threads after count tasks were added
+    void WakeThreads(int count);
+
+    // Indexes per chunk for a loop of count indexes, grain > 0 is taken as is
+    int ChunkSize(int count, int grain) const;
+
+    // Run chunk(c) for every c in [0, num_chunks) on the calling thread and the pool threads, return when all
+    // are done. Only as many pool tasks as threads are enqueued, they take chunks until none are left.
+    void RunChunks(int num_chunks, const std::function<void(int)> &chunk, TaskPriority priority);
+
     // Vector to store worker threads
     std::vector<std::thread> threads_;
 
-    // Queue of tasks
-    std::queue<std::function<void()>> tasks_;
+    PoolScheduler scheduler_;
+
+    // Core of each thread when they are pinned, empty otherwise
+    std::vector<int> thread_cores_;
+
+    // Queues of tasks per priority. The only queues of the shared scheduler, with work stealing the way in for
+    // other threads and for the high priority tasks, with the lock-free scheduler where tasks go when a ring is full.
+    std::queue<QueuedTask> tasks_[NUM_OF_TASK_PRIORITIES];
+
+    // Lock-free queues per priority, only used by the lock-free scheduler
+    std::unique_ptr<MpmcQueue<QueuedTask> > rings_[NUM_OF_TASK_PRIORITIES];
+
+    // Where the threads of the lock-free scheduler sleep, instead of wake_mutex_ and cv_
+    EventCount event_count_;
 
     // Mutex to synchronize access to shared data
     std::mutex queue_mutex_;
 
+    // One deque per thread, only used with work stealing
+    std::vector<std::unique_ptr<WorkStealingDeque<TaskNode *> > > deques_;
+
+    // Nodes each thread can reuse, only touched by the thread of the same index
+    std::vector<std::vector<TaskNode *> > free_nodes_;
+
+    // Guards the sleeping of the threads, so a wake up can't be missed
+    std::mutex wake_mutex_;
+
     // Condition variable to signal changes in the state of the tasks queue
     std::condition_variable cv_;
 
+    // Guards the wait for all the tasks to finish
+    std::mutex done_mutex_;
+
     // Additional condition variable for waiting on task completion
     std::condition_variable tasks_done_cv_;
 
-    // Counter for active tasks
+    // Counter for tasks that were enqueued and didn't finish yet
     std::atomic<int> active_tasks_{0};
 
+    // Counter for tasks that were enqueued and didn't start yet
+    std::atomic<int> queued_tasks_{0};
+
+    // Counters for tasks in tasks_, let the threads skip queue_mutex_ when a queue is empty
+    std::atomic<int> shared_tasks_[NUM_OF_TASK_PRIORITIES];
+
+    // Telemetry of each thread, and the Now() the pool started at
+    std::vector<std::unique_ptr<WorkerCounters> > counters_;
+    int64_t start_time_ = 0;
+
+    // Thread of the periodic telemetry dumps, if the config asked for them
+    std::thread dump_thread_;
+    std::mutex dump_mutex_;
+    std::condition_variable dump_cv_;
+    bool stop_dump_ = false;
+
+    // Counter for threads waiting on cv_
+    std::atomic<int> sleeping_threads_{0};
+
     // Flag to indicate whether the thread pool should stop or not
-    bool stop_ = false;
+    std::atomic<bool> stop_{false};
+
+    // The pool and index of the pool thread running on this thread, nullptr on other threads
+    static thread_local ThreadPool *current_pool_;
+    static thread_local unsigned int current_index_;
+
+    // State of the random victim choice of the pool thread running on this thread
+    static thread_local unsigned int random_state_;
+
+    // High priority tasks the pool thread on this thread ran in a row
+    static thread_local int high_streak_;
+
+    // When the pool thread on this thread took its last task, RunTask times the task from there to save a clock read
+    static thread_local int64_t take_time_;
+};
+
+// Tasks that are waited for together, so several users can share one pool and a task can wait for the tasks it
+// started. Waiting on a pool thread runs pending tasks of the pool instead of blocking the thread.
+// The group has a cancellation token: once it is cancelled, or its deadline passed, or the parent token was
+// cancelled, tasks of the group that didn't start yet are skipped, and the running ones can poll GetToken().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool,
+                       CancellationToken::Clock::time_point deadline = CancellationToken::Clock::time_point::max(),
+                       const CancellationToken &parent = CancellationToken())
+            : pool_(pool), token_(CancellationToken::Create(deadline, parent)) {}
+
+    // The tasks point to the group, so it can't go away before they are done
+    ~TaskGroup() { Wait(); }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // Enqueue function on the pool as part of the group, tasks of the group may add more tasks to it
+    template<typename Function>
+    void Run(Function &&function, TaskPriority priority = LOW_PRIORITY) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.Enqueue([this, function = std::forward<Function>(function)]() mutable {
+            if (!token_.IsCancelled()) {
+                function();
+            }
+            Done();
+        }, priority);
+    }
+
+    // Wait for all the tasks of the group, the group can be used again after that
+    void Wait();
+
+    // Ask the tasks of the group to stop, Wait still has to be called
+    void Cancel() { token_.Cancel(); }
+
+    // Token for the running tasks to poll, and to pass on to work they start
+    const CancellationToken &GetToken() const { return token_; }
+
+private:
+    // Count a task of the group as done
+    void Done();
+
+    ThreadPool &pool_;
+    CancellationToken token_;
+
+    // Counter for tasks of the group that didn't finish yet
+    std::atomic<int> pending_{0};
+
+    // Guards the wait on done_cv_ and the last Done, so the group isn't destroyed under it
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
 };
 
 #endif //THREADPOOL_H
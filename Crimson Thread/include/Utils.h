@@ -27,6 +27,7 @@ const int GRID_SIZE = 101;
 const int GRID_WIDTH = 201;
 const int GRID_HEIGHT = 51;
 const int SUBGRID_SIZE = 25;
+const int MAX_STATIONS = (GRID_WIDTH / SUBGRID_SIZE) * (GRID_HEIGHT / SUBGRID_SIZE); // One station per subgrid
 const char	WALL = 219;			// █
 const char	PATH = 32;			// | |<- Space
 const char	HOSTAGES = 64;		// @
@@ -0,0 +1,129 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//----CONSTANTS------------------------------------------------------
+const int DEQUE_INITIAL_CAPACITY_BITS = 8; // A deque starts with 256 slots and doubles when full
+
+//----CLASS------------------------------------------------------
+// Chase-Lev work-stealing deque (the C11 version of Le et al.), T must be a pointer.
+// The fences of the paper are folded into release and seq_cst operations on top_ and bottom_, which costs the
+// same on x86 and lets the thread sanitizer follow the synchronization.
+// Only the owner thread calls Push and Pop, which work on the bottom end like a stack.
+// Any thread can call Steal, which takes from the top end, so thieves get the oldest items.
+template<typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(int capacityBits = DEQUE_INITIAL_CAPACITY_BITS)
+            : array_(new Array(int64_t(1) << capacityBits)) {
+    }
+
+    ~WorkStealingDeque() {
+        delete array_.load(std::memory_order_relaxed);
+        for (Array *array: retired_) {
+            delete array;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only, add an item at the bottom
+    void Push(T item) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array *array = array_.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1) {
+            array = Grow(array, top, bottom);
+        }
+        array->Put(bottom, item);
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only, take the newest item, return false if the deque is empty
+    bool Pop(T &item) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *array = array_.load(std::memory_order_relaxed);
+        bottom_.exchange(bottom, std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_seq_cst);
+
+        if (top > bottom) {
+            // Empty, put the bottom back
+            bottom_.store(bottom + 1, std::memory_order_release);
+            return false;
+        }
+
+        item = array->Get(bottom);
+        if (top == bottom) {
+            // Last item, race the thieves for it
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_release);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, take the oldest item. Returns false if the deque is empty or another thread won the item.
+    bool Steal(T &item) {
+        int64_t top = top_.load(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+        if (top >= bottom) {
+            return false;
+        }
+
+        // The array can't be freed under us, grown arrays are only deleted with the deque
+        Array *array = array_.load(std::memory_order_acquire);
+        item = array->Get(top);
+        return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Number of items, only exact when no other thread is using the deque
+    int64_t Size() const {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? bottom - top : 0;
+    }
+
+private:
+    struct Array {
+        int64_t capacity;
+        std::atomic<T> *items;
+
+        explicit Array(int64_t capacity) : capacity(capacity), items(new std::atomic<T>[capacity]) {
+        }
+
+        ~Array() {
+            delete[] items;
+        }
+
+        T Get(int64_t index) const {
+            return items[index & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t index, T item) {
+            items[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    // Owner only, copy the items to an array twice as big. The old array is kept since a thief may still read it.
+    Array *Grow(Array *array, int64_t top, int64_t bottom) {
+        Array *bigger = new Array(array->capacity * 2);
+        for (int64_t i = top; i < bottom; ++i) {
+            bigger->Put(i, array->Get(i));
+        }
+        retired_.push_back(array);
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(64) std::atomic<int64_t> top_{0}; // Next item to steal, thieves and the owner move it with CAS
+    alignas(64) std::atomic<int64_t> bottom_{0}; // Next free slot, only the owner writes it
+    std::atomic<Array *> array_;
+    std::vector<Array *> retired_; // Arrays replaced by Grow, owner only
+};
+
+#endif //WORK_STEALING_DEQUE_H
@@ -0,0 +1,355 @@
+//----INCLUDES--------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <random>
+#include "include/ALNS.h"
+#include "include/Construction.h"
+#include "include/RouteOptimizer.h"
+#include "include/Visualizer.h"
+
+//----TYPES------------------------------------------------------
+enum DestroyOperator {
+    RANDOM_REMOVAL,
+    WORST_REMOVAL, // Stations with the least PValue per step they cost
+    RELATED_REMOVAL, // A station and the ones closest to it, so the repair can rearrange a whole area
+    NUM_OF_DESTROY_OPERATORS
+};
+
+enum RepairOperator {
+    GREEDY_REPAIR,
+    REGRET_REPAIR,
+    RANDOMIZED_REPAIR,
+    NUM_OF_REPAIR_OPERATORS
+};
+
+//----CONSTANTS------------------------------------------------------
+// Segment scores of an operator pair, as in Ropke and Pisinger
+const double SCORE_NEW_BEST = 33;
+const double SCORE_BETTER = 9;
+const double SCORE_ACCEPTED = 13;
+
+//----STRUCT------------------------------------------------------
+struct ALNSSolution {
+    vector<vector<LocationID> > plan;
+    double pValue = 0;
+    int steps = 0;
+
+    double Objective() const {
+        return pValue - ALNS_STEP_PENALTY * steps;
+    }
+};
+
+// Roulette weights of one group of operators
+struct OperatorWeights {
+    vector<double> weights;
+    vector<double> scores; // Collected in the current segment
+    vector<int> uses;
+};
+
+//----FUNCTIONS-------------------------------------------------------
+static void InitWeights(OperatorWeights &operatorWeights, int numOfOperators) {
+    operatorWeights.weights.assign(numOfOperators, 1.0);
+    operatorWeights.scores.assign(numOfOperators, 0.0);
+    operatorWeights.uses.assign(numOfOperators, 0);
+}
+
+static int SelectOperator(const OperatorWeights &operatorWeights, std::mt19937 &rng) {
+    double total = 0;
+    for (double weight: operatorWeights.weights) {
+        total += weight;
+    }
+
+    double pick = std::uniform_real_distribution<double>(0, total)(rng);
+    for (int o = 0; o < operatorWeights.weights.size() - 1; ++o) {
+        pick -= operatorWeights.weights[o];
+        if (pick < 0) {
+            return o;
+        }
+    }
+    return static_cast<int>(operatorWeights.weights.size()) - 1;
+}
+
+// Move the weights towards the average score each operator got in the segment
+static void UpdateWeights(OperatorWeights &operatorWeights) {
+    for (int o = 0; o < operatorWeights.weights.size(); ++o) {
+        if (operatorWeights.uses[o] > 0) {
+            double averageScore = operatorWeights.scores[o] / operatorWeights.uses[o];
+            operatorWeights.weights[o] = (1 - ALNS_REACTION_FACTOR) * operatorWeights.weights[o] +
+                                         ALNS_REACTION_FACTOR * std::max(averageScore, 0.1);
+        }
+        operatorWeights.scores[o] = 0;
+        operatorWeights.uses[o] = 0;
+    }
+}
+
+static void EvaluateSolution(ALNSSolution &solution, const DistanceMatrix &distances,
+                             HostageStation **hostageStations) {
+    solution.pValue = SumPValue(solution.plan, hostageStations);
+    solution.steps = 0;
+    for (const vector<LocationID> &path: solution.plan) {
+        solution.steps += PathDistance(path, distances);
+    }
+}
+
+// Take the stations at the given (unit, index) places out of the plan
+static void RemoveStations(vector<vector<LocationID> > &plan, vector<pair<int, int> > places) {
+    // Erase from the back of each path so the other indexes stay correct
+    std::sort(places.begin(), places.end(), std::greater<pair<int, int> >());
+    for (const pair<int, int> &place: places) {
+        plan[place.first].erase(plan[place.first].begin() + place.second);
+    }
+}
+
+// Works on plans, not chromosomes: the GA removal mutation drops one random station, so the scored removals use
+// RemovalGain, which the GA's memetic relocate move uses too
+static void Destroy(vector<vector<LocationID> > &plan, DestroyOperator destroyOperator, const DistanceMatrix &distances,
+                    HostageStation **hostageStations, std::mt19937 &rng) {
+    // All the (unit, index) places that hold a station
+    vector<pair<int, int> > places;
+    for (int u = 0; u < plan.size(); ++u) {
+        for (int s = 1; s < plan[u].size(); ++s) {
+            places.emplace_back(u, s);
+        }
+    }
+    if (places.empty()) {
+        return;
+    }
+
+    int maxToRemove = std::max(1, static_cast<int>(places.size()) * ALNS_MAX_REMOVED / 100);
+    int numToRemove = std::uniform_int_distribution<int>(1, maxToRemove)(rng);
+
+    switch (destroyOperator) {
+        case RANDOM_REMOVAL:
+            std::shuffle(places.begin(), places.end(), rng);
+            break;
+        case WORST_REMOVAL: {
+            // Least PValue per saved step first, with some noise so the same stations don't always go
+            vector<pair<double, pair<int, int> > > byValue;
+            std::uniform_real_distribution<double> noise(0.8, 1.2);
+            for (const pair<int, int> &place: places) {
+                LocationID station = plan[place.first][place.second];
+                int gain = RemovalGain(plan[place.first], place.second, distances);
+                double value = hostageStations[station]->GetPValue() / std::max(gain, 1) * noise(rng);
+                byValue.emplace_back(value, place);
+            }
+            std::sort(byValue.begin(), byValue.end());
+            for (int i = 0; i < places.size(); ++i) {
+                places[i] = byValue[i].second;
+            }
+            break;
+        }
+        case RELATED_REMOVAL: {
+            // Closest to a random station of the plan first, the station itself has distance 0
+            pair<int, int> seed = places[rng() % places.size()];
+            LocationID seedStation = plan[seed.first][seed.second];
+            vector<pair<int, pair<int, int> > > byDistance;
+            for (const pair<int, int> &place: places) {
+                int cost = distances.GetCost(seedStation, plan[place.first][place.second]);
+                byDistance.emplace_back(cost == -1 ? INT_MAX : cost, place);
+            }
+            std::sort(byDistance.begin(), byDistance.end());
+            for (int i = 0; i < places.size(); ++i) {
+                places[i] = byDistance[i].second;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    places.resize(numToRemove);
+    RemoveStations(plan, places);
+}
+
+// CompletePlan is the insertion the GA seeds and warm starts its population with. The GA mutation inserts one
+// random station into a Chromosome, which can't refill a plan that lost several.
+static void Repair(vector<vector<LocationID> > &plan, RepairOperator repairOperator, const DistanceMatrix &distances,
+                   const vector<pair<LocationID, Point> > &importantPoints, HostageStation **hostageStations,
+                   int stepBudget, std::mt19937 &rng) {
+    InsertionRule rule = repairOperator == REGRET_REPAIR ? REGRET_INSERTION : CHEAPEST_INSERTION;
+    int numOfCandidates = repairOperator == RANDOMIZED_REPAIR ? RANDOM_CONSTRUCTION_CANDIDATES : 1;
+    CompletePlan(plan, distances, importantPoints, hostageStations, stepBudget, rule, numOfCandidates, rng);
+
+    // Shorter routes leave room for one more station
+    for (vector<LocationID> &path: plan) {
+        OrderPath(path, distances);
+    }
+    CompletePlan(plan, distances, importantPoints, hostageStations, stepBudget, rule, 1, rng);
+}
+
+vector<vector<LocationID>> ALNSAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                         const vector<pair<LocationID, Point> > &importantPoints,
+                                         int numOfUnits, HostageStation **hostageStations,
+                                         const GAOptions &options) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: ALNSAlgorithm received in valid input");
+        return vector<vector<LocationID> >();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    DistanceMatrix ownDistances;
+    if (options.distances == nullptr) {
+        ownDistances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+    }
+    const DistanceMatrix &distances = options.distances != nullptr ? *options.distances : ownDistances;
+    double upperBound = PValueUpperBound(distances, importantPoints, numOfUnits, hostageStations, options.stepBudget);
+    std::mt19937 rng(std::random_device{}());
+
+    // Track the best plan here if the caller doesn't want to
+    BestPlanTracker localBestSoFar;
+    BestPlanTracker *bestSoFar = options.bestSoFar != nullptr ? options.bestSoFar : &localBestSoFar;
+
+    // Start from the fast plan
+    ALNSSolution current;
+    current.plan = FastPlan(distances, importantPoints, numOfUnits, hostageStations, options.stepBudget);
+    EvaluateSolution(current, distances, hostageStations);
+    ALNSSolution best = current;
+    bestSoFar->Offer(best.plan, best.pValue, ALNS_ENGINE);
+
+    OperatorWeights destroyWeights;
+    OperatorWeights repairWeights;
+    InitWeights(destroyWeights, NUM_OF_DESTROY_OPERATORS);
+    InitWeights(repairWeights, NUM_OF_REPAIR_OPERATORS);
+
+    double temperature = ALNS_START_TEMPERATURE;
+    int iterationsWithoutImprovement = 0;
+    double secondsToTarget = -1;
+    int iteration = 0;
+    for (; iteration < ALNS_ITERATIONS; ++iteration) {
+        // Check the stop criteria, the shared best plan also counts
+        double sharedFitness = bestSoFar->GetFitness();
+        auto now = std::chrono::steady_clock::now();
+        if (options.targetFitness >= 0 && sharedFitness >= options.targetFitness - PVALUE_EPSILON &&
+            secondsToTarget < 0) {
+            secondsToTarget = std::chrono::duration<double>(now - start).count();
+        }
+        if (now >= options.deadline || options.cancel.IsCancelled() ||
+            (options.maxStagnantGenerations > 0 && iterationsWithoutImprovement >= options.maxStagnantGenerations) ||
+            (options.targetFitness >= 0 && sharedFitness >= options.targetFitness - PVALUE_EPSILON) ||
+            (options.stopAtUpperBound && sharedFitness >= upperBound - PVALUE_EPSILON)) {
+            break;
+        }
+        if (options.onProgress && options.progressInterval > 0 && iteration % options.progressInterval == 0) {
+            GAProgress progress;
+            progress.generation = iteration;
+            progress.bestFitness = sharedFitness;
+            progress.generationsWithoutImprovement = iterationsWithoutImprovement;
+            progress.elapsedSeconds = std::chrono::duration<double>(now - start).count();
+            progress.upperBound = upperBound;
+            progress.stats.evaluations = iteration;
+            progress.bestPlan = bestSoFar->GetPlan();
+            if (!options.onProgress(progress)) {
+                break;
+            }
+        }
+
+        // Continue from a better plan another engine found
+        if (iteration % ALNS_SHARE_INTERVAL == 0 && sharedFitness > best.pValue + PVALUE_EPSILON) {
+            current.plan = bestSoFar->GetPlan();
+            EvaluateSolution(current, distances, hostageStations);
+            best = current;
+        }
+
+        int destroyOperator = SelectOperator(destroyWeights, rng);
+        int repairOperator = SelectOperator(repairWeights, rng);
+
+        ALNSSolution candidate;
+        candidate.plan = current.plan;
+        Destroy(candidate.plan, static_cast<DestroyOperator>(destroyOperator), distances, hostageStations, rng);
+        Repair(candidate.plan, static_cast<RepairOperator>(repairOperator), distances, importantPoints,
+               hostageStations, options.stepBudget, rng);
+        EvaluateSolution(candidate, distances, hostageStations);
+
+        // Simulated annealing acceptance
+        double score = 0;
+        double difference = candidate.Objective() - current.Objective();
+        if (candidate.Objective() > best.Objective() + PVALUE_EPSILON) {
+            best = candidate;
+            current = candidate;
+            score = SCORE_NEW_BEST;
+            bestSoFar->Offer(best.plan, best.pValue, ALNS_ENGINE);
+            iterationsWithoutImprovement = 0;
+        } else {
+            ++iterationsWithoutImprovement;
+            if (difference > PVALUE_EPSILON) {
+                current = candidate;
+                score = SCORE_BETTER;
+            } else if (std::uniform_real_distribution<double>(0, 1)(rng) < std::exp(difference / temperature)) {
+                current = candidate;
+                score = SCORE_ACCEPTED;
+            }
+        }
+
+        destroyWeights.scores[destroyOperator] += score;
+        destroyWeights.uses[destroyOperator]++;
+        repairWeights.scores[repairOperator] += score;
+        repairWeights.uses[repairOperator]++;
+        if ((iteration + 1) % ALNS_SEGMENT_LENGTH == 0) {
+            UpdateWeights(destroyWeights);
+            UpdateWeights(repairWeights);
+        }
+
+        temperature *= ALNS_COOLING_RATE;
+    }
+
+    // The last iteration may have reached the target
+    if (options.targetFitness >= 0 && bestSoFar->GetFitness() >= options.targetFitness - PVALUE_EPSILON &&
+        secondsToTarget < 0) {
+        secondsToTarget = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (options.stats != nullptr) {
+        *options.stats = GAStats();
+        options.stats->evaluations = iteration;
+        options.stats->secondsToTarget = secondsToTarget;
+        options.stats->bestEngine = ALNS_ENGINE;
+    }
+
+    return best.plan;
+}
+
+vector<vector<LocationID>> PortfolioAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                              const vector<pair<LocationID, Point> > &importantPoints,
+                                              int numOfUnits, HostageStation **hostageStations,
+                                              const GAOptions &options) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: PortfolioAlgorithm received in valid input");
+        return vector<vector<LocationID> >();
+    }
+
+    // Both engines offer their improvements to the same tracker and stop on its fitness
+    BestPlanTracker localBestSoFar;
+    GAOptions engineOptions = options;
+    engineOptions.bestSoFar = options.bestSoFar != nullptr ? options.bestSoFar : &localBestSoFar;
+
+    // The callback is only given to the GA so it is never called from two threads at once
+    GAStats alnsStats;
+    GAOptions alnsOptions = engineOptions;
+    alnsOptions.onProgress = nullptr;
+    alnsOptions.stats = &alnsStats;
+
+    vector<vector<LocationID> > gaPlan;
+    vector<vector<LocationID> > alnsPlan;
+    thread alnsThread([&]() {
+        alnsPlan = ALNSAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, alnsOptions);
+    });
+    gaPlan = MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, engineOptions);
+    alnsThread.join();
+
+    // The GA filled the stats, add when the first of the two saw the target and who offered the best plan
+    if (options.stats != nullptr) {
+        if (alnsStats.secondsToTarget >= 0 &&
+            (options.stats->secondsToTarget < 0 || alnsStats.secondsToTarget < options.stats->secondsToTarget)) {
+            options.stats->secondsToTarget = alnsStats.secondsToTarget;
+        }
+        options.stats->bestEngine = engineOptions.bestSoFar->GetEngine();
+    }
+
+    // Both engines return plans with ordered routes
+    if (SumPValue(alnsPlan, hostageStations) > SumPValue(gaPlan, hostageStations) + PVALUE_EPSILON) {
+        return alnsPlan;
+    }
+    return gaPlan;
+}
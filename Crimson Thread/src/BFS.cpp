@@ -156,18 +156,19 @@ void ReconstructPaths(Point **parentGrid, LocationID startID, Point start, vecto
     }
 }
 
-void Search(char **grid, Point start, Point **parentGrid) {
+// Returns false if the search was cancelled before it covered the grid
+bool Search(char **grid, Point start, Point **parentGrid, const CancellationToken &cancel) {
     if (grid == nullptr) {
         PrintError("Error: Search received a null grid.\n");
-        return;
+        return false;
     }
     if (parentGrid == nullptr) {
         PrintError("Error: Search received a null parentGrid.\n");
-        return;
+        return false;
     }
     if (!IsInArrayBounds(start)) {
         PrintError("Error: Search received an out-of-bound start point.\n");
-        return;
+        return false;
     }
 
     queue<Point> uncheckedPoints{};
@@ -179,7 +180,13 @@ void Search(char **grid, Point start, Point **parentGrid) {
     AddToOpen(x, y, uncheckedPoints, grid);
 
     // Continue the search as long as there are points left in the queue.
+    int expanded = 0;
     while (!uncheckedPoints.empty()) {
+        // Stop early if nobody wants the paths anymore
+        if (++expanded % SEARCH_CANCEL_POLL_INTERVAL == 0 && cancel.IsCancelled()) {
+            return false;
+        }
+
         // Get the next point from the front of the queue and remove it.
         Point currentPoint = uncheckedPoints.front();
         uncheckedPoints.pop();
@@ -190,10 +197,11 @@ void Search(char **grid, Point start, Point **parentGrid) {
         // Insert unvisited neighbors to queue
         ExpandNeighbors(currentPoint, uncheckedPoints, grid, parentGrid);
     }
+    return true;
 }
 
 void BFS(char **grid, LocationID startID, Point start, vector<pair<LocationID, Point>> importantPoints,
-         map<PathKey, vector<Point> > &pathsBetweenStations, mutex &pathMapMutex) {
+         map<PathKey, vector<Point> > &pathsBetweenStations, mutex &pathMapMutex, const CancellationToken &cancel) {
     if (grid == nullptr) {
         PrintError("Error: BFS received a null grid.\n");
         return;
@@ -234,11 +242,11 @@ void BFS(char **grid, LocationID startID, Point start, vector<pair<LocationID, P
         }
     }
 
-    // Execute BFS search from start and fill parentGrid
-    Search(navGrid, start, parentGrid);
-
-    // Reconstruct paths from start to all important points with higher ID.
-    ReconstructPaths(parentGrid, startID, start, importantPoints, pathsBetweenStations, pathMapMutex);
+    // Execute BFS search from start and fill parentGrid, a cancelled search has only part of the paths
+    if (Search(navGrid, start, parentGrid, cancel)) {
+        // Reconstruct paths from start to all important points with higher ID.
+        ReconstructPaths(parentGrid, startID, start, importantPoints, pathsBetweenStations, pathMapMutex);
+    }
 
     // Deallocate the memory used by navGrid and parentGrid.
     DeallocateGrid(navGrid);
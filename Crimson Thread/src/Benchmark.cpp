@@ -0,0 +1,424 @@
+//----INCLUDES--------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "include/Benchmark.h"
+#include "include/BFS.h"
+#include "include/Construction.h"
+#include "include/GeneticAlgorithm.h"
+#include "include/ParallelRegion.h"
+#include "include/Planner.h"
+#include "include/RouteOptimizer.h"
+#include "include/Visualizer.h"
+
+//----FUNCTIONS-------------------------------------------------------
+// Same work as the GA fitness: walk the routes through the BFS paths, check the budget and sum the PValue
+static double PlanFitness(const vector<vector<LocationID> > &plan,
+                          const map<PathKey, vector<Point> > &pathsBetweenStations, HostageStation **hostageStations) {
+    double fitness = 0;
+    for (const vector<LocationID> &unitPath: plan) {
+        int steps = 0;
+        for (int s = 1; s < unitPath.size(); ++s) {
+            steps += GetPathCost(unitPath[s - 1], unitPath[s], pathsBetweenStations);
+            fitness += hostageStations[unitPath[s]]->GetPValue();
+        }
+        if (steps > UNIT_STEP_BUDGET) {
+            return 0;
+        }
+    }
+    return fitness;
+}
+
+// Seconds per batch of the fastest repeat, each batch enqueues batchSize tasks and waits for all of them.
+// bulk submits the whole batch with one EnqueueBulk instead of one Enqueue per task.
+static double TimeBatches(ThreadPool &pool, int batchSize, const std::function<void(int)> &task, bool bulk) {
+    double bestSeconds = -1;
+    for (int repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        for (int batch = 0; batch < BENCHMARK_BATCHES; ++batch) {
+            if (bulk) {
+                pool.EnqueueBulk(0, batchSize, std::ref(task));
+            } else {
+                for (int i = 0; i < batchSize; ++i) {
+                    pool.Enqueue([&task, i]() {
+                        task(i);
+                    });
+                }
+            }
+            pool.WaitAll();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (bestSeconds < 0 || seconds < bestSeconds) {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds / BENCHMARK_BATCHES;
+}
+
+void BenchmarkSchedulers(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                         const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                         unsigned int numOfThreads) {
+    const char *schedulerNames[] = {"Shared queue", "Work stealing", "Lock-free queue"};
+    PoolScheduler schedulers[] = {SHARED_QUEUE_SCHEDULER, WORK_STEALING_SCHEDULER, LOCK_FREE_QUEUE_SCHEDULER};
+
+    printf("\nScheduler benchmark: %d batches of %d tasks on %u threads\n", BENCHMARK_BATCHES, BENCHMARK_BATCH_SIZE,
+           numOfThreads);
+    printf("%-15s %18s %18s %18s %18s\n", "Scheduler", "Empty task (ns)", "Empty bulk (ns)", "Fitness task (ns)",
+           "Fitness bulk (us)");
+
+    for (int s = 0; s < 3; ++s) {
+        ThreadPool pool(numOfThreads, schedulers[s]);
+
+        // Only the scheduling cost
+        std::atomic<long long> emptyCount{0};
+        std::function<void(int)> emptyTask = [&emptyCount](int) {
+            emptyCount.fetch_add(1, std::memory_order_relaxed);
+        };
+        double emptySeconds = TimeBatches(pool, BENCHMARK_BATCH_SIZE, emptyTask, false);
+        double emptyBulkSeconds = TimeBatches(pool, BENCHMARK_BATCH_SIZE, emptyTask, true);
+
+        // One fitness evaluation per task, like EvaluatePopulationFitness
+        vector<double> fitness(BENCHMARK_BATCH_SIZE);
+        std::function<void(int)> fitnessTask = [&](int i) {
+            fitness[i] = PlanFitness(plans[i % plans.size()], pathsBetweenStations, hostageStations);
+        };
+        double fitnessSeconds = TimeBatches(pool, BENCHMARK_BATCH_SIZE, fitnessTask, false);
+        double fitnessBulkSeconds = TimeBatches(pool, BENCHMARK_BATCH_SIZE, fitnessTask, true);
+
+        printf("%-15s %18.1f %18.1f %18.1f %18.2f\n", schedulerNames[s], emptySeconds / BENCHMARK_BATCH_SIZE * 1e9,
+               emptyBulkSeconds / BENCHMARK_BATCH_SIZE * 1e9, fitnessSeconds / BENCHMARK_BATCH_SIZE * 1e9,
+               fitnessBulkSeconds * 1e6);
+    }
+}
+
+void BenchmarkQueueBackends(unsigned int numOfThreads) {
+    printf("\nQueue benchmark: %d producers enqueue %d rounds of %d empty tasks each on %u threads\n",
+           BENCHMARK_PRODUCERS, BENCHMARK_PRODUCER_ROUNDS, BENCHMARK_PRODUCER_BURST, numOfThreads);
+    printf("%-15s %10s %17s %17s %17s %14s %14s %16s\n", "Queue", "Mtasks/s", "Enqueue p50 (ns)",
+           "Enqueue p99 (ns)", "Enqueue max (us)", "Wait p50 (us)", "Wait p99 (us)", "Wait p99.9 (us)");
+
+    const char *backendNames[] = {"Locked queue", "Lock-free ring"};
+    PoolScheduler backends[] = {SHARED_QUEUE_SCHEDULER, LOCK_FREE_QUEUE_SCHEDULER};
+    for (int b = 0; b < 2; ++b) {
+        ThreadPool pool(numOfThreads, backends[b]);
+
+        // A histogram takes one writer, so every producer times its Enqueue calls in its own
+        vector<std::unique_ptr<Histogram> > enqueueTimes;
+        for (int p = 0; p < BENCHMARK_PRODUCERS; ++p) {
+            enqueueTimes.emplace_back(new Histogram());
+        }
+        std::atomic<bool> start{false};
+        vector<std::thread> producers;
+        for (int p = 0; p < BENCHMARK_PRODUCERS; ++p) {
+            producers.emplace_back([&pool, &enqueueTimes, &start, p]() {
+                Histogram &times = *enqueueTimes[p];
+                std::atomic<int> done{0};
+                while (!start.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (int round = 0; round < BENCHMARK_PRODUCER_ROUNDS; ++round) {
+                    for (int i = 0; i < BENCHMARK_PRODUCER_BURST; ++i) {
+                        auto sent = std::chrono::steady_clock::now();
+                        pool.Enqueue([&done]() {
+                            done.fetch_add(1, std::memory_order_release);
+                        });
+                        times.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - sent).count());
+                    }
+
+                    // Wait for the round, so the ring never fills up and the tasks never go to the locked queue
+                    while (done.load(std::memory_order_acquire) < (round + 1) * BENCHMARK_PRODUCER_BURST) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true, std::memory_order_release);
+        for (std::thread &producer: producers) {
+            producer.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        pool.WaitAll();
+
+        HistogramSnapshot enqueue;
+        for (const std::unique_ptr<Histogram> &times: enqueueTimes) {
+            enqueue.Merge(times->Snapshot());
+        }
+        HistogramSnapshot wait = pool.GetTelemetry().queue_wait[LOW_PRIORITY];
+        printf("%-15s %10.2f %17lld %17lld %17.1f %14.1f %14.1f %16.1f\n", backendNames[b],
+               enqueue.total / seconds / 1e6, enqueue.Percentile(0.5), enqueue.Percentile(0.99), enqueue.max / 1e3,
+               wait.Percentile(0.5) / 1e3, wait.Percentile(0.99) / 1e3, wait.Percentile(0.999) / 1e3);
+    }
+}
+
+// Seconds per step of the fastest repeat, each step is one parallelFor call over stepSize indexes
+static double TimeSteps(const std::function<void(int, int, const std::function<void(int)> &)> &parallelFor,
+                        int stepSize, const std::function<void(int)> &body) {
+    double bestSeconds = -1;
+    for (int repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < BENCHMARK_BATCHES; ++step) {
+            parallelFor(0, stepSize, body);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (bestSeconds < 0 || seconds < bestSeconds) {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds / BENCHMARK_BATCHES;
+}
+
+// Seconds per generation of a GA run with a fixed number of generations
+static double TimeGAGenerations(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                HostageStation **hostageStations, ThreadPool &pool, bool persistentRegion) {
+    GAOptions options;
+    options.maxGenerations = BENCHMARK_GA_GENERATIONS;
+    options.stopAtUpperBound = false;
+    options.pool = &pool;
+    options.persistentRegion = persistentRegion;
+
+    auto start = std::chrono::steady_clock::now();
+    MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / BENCHMARK_GA_GENERATIONS;
+}
+
+void BenchmarkParallelRegion(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                             const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                             const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                             unsigned int numOfThreads) {
+    printf("\nParallel region benchmark: %d steps of %d indexes on %u threads, GA of %d generations\n",
+           BENCHMARK_BATCHES, BENCHMARK_BATCH_SIZE, numOfThreads, BENCHMARK_GA_GENERATIONS);
+    printf("%-15s %18s %18s %18s\n", "Steps on", "Empty step (us)", "Fitness step (us)", "GA generation (us)");
+
+    std::atomic<long long> emptyCount{0};
+    std::function<void(int)> emptyBody = [&emptyCount](int) {
+        emptyCount.fetch_add(1, std::memory_order_relaxed);
+    };
+    vector<double> fitness(BENCHMARK_BATCH_SIZE);
+    std::function<void(int)> fitnessBody = [&](int i) {
+        fitness[i] = PlanFitness(plans[i % plans.size()], pathsBetweenStations, hostageStations);
+    };
+
+    const char *modeNames[] = {"Thread pool", "Parallel region"};
+    for (int mode = 0; mode < 2; ++mode) {
+        bool persistent = mode == 1;
+        ThreadPool pool(numOfThreads);
+        double emptySeconds, fitnessSeconds;
+        {
+            ParallelRegion region(pool, persistent);
+            auto parallelFor = [&region](int begin, int end, const std::function<void(int)> &body) {
+                region.ParallelFor(begin, end, 0, body);
+            };
+
+            emptySeconds = TimeSteps(parallelFor, BENCHMARK_BATCH_SIZE, emptyBody);
+            fitnessSeconds = TimeSteps(parallelFor, BENCHMARK_BATCH_SIZE, fitnessBody);
+        }
+
+        // The GA makes its own region on the same pool, time it after ours gave the pool threads back
+        double generationSeconds = TimeGAGenerations(pathsBetweenStations, importantPoints, numOfUnits,
+                                                     hostageStations, pool, persistent);
+
+        printf("%-15s %18.2f %18.2f %18.1f\n", modeNames[mode], emptySeconds * 1e6, fitnessSeconds * 1e6,
+               generationSeconds * 1e6);
+    }
+}
+
+void BenchmarkPriorities(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                         const vector<vector<vector<LocationID> > > &plans, HostageStation **hostageStations,
+                         unsigned int numOfThreads) {
+    printf("\nPriority benchmark: %d probes every %d us while %d fitness tasks run on %u threads\n",
+           BENCHMARK_PROBES, BENCHMARK_PROBE_INTERVAL, BENCHMARK_BULK_TASKS, numOfThreads);
+    printf("%-15s %16s %16s %16s %16s\n", "Probes sent as", "Probe mean (us)", "Probe max (us)", "Bulk mean (us)",
+           "Bulk max (us)");
+
+    const char *priorityNames[] = {"High priority", "Low priority"};
+    TaskPriority priorities[] = {HIGH_PRIORITY, LOW_PRIORITY};
+    for (int p = 0; p < 2; ++p) {
+        ThreadPool pool(numOfThreads);
+        vector<double> fitness(BENCHMARK_BULK_TASKS);
+        pool.EnqueueBulk(0, BENCHMARK_BULK_TASKS, [&](int i) {
+            fitness[i] = PlanFitness(plans[i % plans.size()], pathsBetweenStations, hostageStations);
+        });
+
+        // Each probe measures its own wait, the pool counts the probes with the bulk when they share a class
+        vector<double> probeWaits(BENCHMARK_PROBES);
+        for (int i = 0; i < BENCHMARK_PROBES; ++i) {
+            auto sent = std::chrono::steady_clock::now();
+            pool.Enqueue([&probeWaits, i, sent]() {
+                probeWaits[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count();
+            }, priorities[p]);
+            std::this_thread::sleep_for(std::chrono::microseconds(BENCHMARK_PROBE_INTERVAL));
+        }
+        pool.WaitAll();
+
+        double sumWait = 0;
+        double maxWait = 0;
+        for (double wait: probeWaits) {
+            sumWait += wait;
+            maxWait = std::max(maxWait, wait);
+        }
+        QueueWaitStats bulk = pool.GetQueueWait(LOW_PRIORITY);
+        printf("%-15s %16.1f %16.1f %16.1f %16.1f\n", priorityNames[p], sumWait / BENCHMARK_PROBES * 1e6,
+               maxWait * 1e6, bulk.mean_microseconds, bulk.max_microseconds);
+    }
+}
+
+void BenchmarkTimeToTarget(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                           const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                           HostageStation **hostageStations, unsigned int numOfThreads, double targetFitness) {
+    ThreadPool pool(numOfThreads);
+
+    // Without a target aim for what a full GA run finds, a share of the upper bound is either in generation 0
+    // already or out of reach
+    double target = targetFitness;
+    if (target < 0) {
+        GAOptions referenceOptions;
+        referenceOptions.pool = &pool;
+        target = SumPValue(MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations,
+                                         referenceOptions), hostageStations);
+    }
+    double upperBound = PValueUpperBound(pathsBetweenStations, importantPoints, numOfUnits, hostageStations,
+                                         UNIT_STEP_BUDGET);
+    printf("\nTime to target benchmark: PValue %.2f%s (upper bound %.2f), %d runs of at most %d s on %u threads\n",
+           target, targetFitness < 0 ? " of a full GA run" : "", upperBound, BENCHMARK_TARGET_RUNS,
+           BENCHMARK_TARGET_SECONDS, numOfThreads);
+    printf("%-20s %8s %16s %16s %14s\n", "Engine", "Reached", "Mean time (ms)", "Max time (ms)", "Accepted (%)");
+
+    const char *engineNames[] = {"GA", "GA no neighbours", "ALNS", "Portfolio"};
+    PlannerType planners[] = {GA_PLANNER, GA_PLANNER, ALNS_PLANNER, PORTFOLIO_PLANNER};
+    bool neighbourMutation[] = {true, false, true, true};
+    int portfolioWins[NUM_OF_PLAN_ENGINES] = {};
+    for (int e = 0; e < 4; ++e) {
+        int reached = 0;
+        double sumSeconds = 0;
+        double maxSeconds = 0;
+        double sumAcceptance = 0;
+        for (int run = 0; run < BENCHMARK_TARGET_RUNS; ++run) {
+            GAStats stats;
+            GAOptions options;
+            options.targetFitness = target;
+            options.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(BENCHMARK_TARGET_SECONDS);
+            options.neighbourMutation = neighbourMutation[e];
+            options.pool = &pool;
+            options.stats = &stats;
+            RunPlanner(planners[e], pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+
+            sumAcceptance += stats.MutationAcceptanceRate();
+            if (stats.secondsToTarget >= 0) {
+                ++reached;
+                sumSeconds += stats.secondsToTarget;
+                maxSeconds = std::max(maxSeconds, stats.secondsToTarget);
+            }
+            if (planners[e] == PORTFOLIO_PLANNER) {
+                ++portfolioWins[stats.bestEngine];
+            }
+        }
+
+        // The times only count the runs that got there, the ALNS has no mutations to accept
+        printf("%-20s %5d/%-2d %16.1f %16.1f ", engineNames[e], reached, BENCHMARK_TARGET_RUNS,
+               reached > 0 ? sumSeconds / reached * 1e3 : 0.0, maxSeconds * 1e3);
+        if (planners[e] == ALNS_PLANNER) {
+            printf("%14s\n", "-");
+        } else {
+            printf("%14.2f\n", sumAcceptance / BENCHMARK_TARGET_RUNS * 100);
+        }
+    }
+    printf("Portfolio best plan offered by the GA in %d runs, by the ALNS in %d runs\n", portfolioWins[GA_ENGINE],
+           portfolioWins[ALNS_ENGINE]);
+}
+
+void BenchmarkScaling(char **grid, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                      const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                      HostageStation **hostageStations, unsigned int maxThreads) {
+    const char *layoutNames[] = {"Floating", "Pinned", "Pinned no SMT"};
+    bool pinThreads[] = {false, true, true};
+    bool skipSmtSiblings[] = {false, false, true};
+
+    // Powers of two and the full count
+    vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(1u, maxThreads));
+
+    printf("\nScaling benchmark: BFS from %d points, GA of %d generations\n", (int) importantPoints.size(),
+           BENCHMARK_GA_GENERATIONS);
+    printf("%-15s %8s %12s %12s %14s %12s\n", "Layout", "Threads", "BFS (ms)", "BFS speedup", "GA (ms)",
+           "GA speedup");
+
+    double baseBFSSeconds = 0;
+    double baseGASeconds = 0;
+    for (int layout = 0; layout < 3; ++layout) {
+        for (unsigned int threads: threadCounts) {
+            PoolConfig config;
+            config.num_threads = threads;
+            config.pin_threads = pinThreads[layout];
+            config.skip_smt_siblings = skipSmtSiblings[layout];
+            ThreadPool pool(config);
+
+            // One BFS per source like main, into a map of its own
+            double bfsSeconds = -1;
+            for (int repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat) {
+                map<PathKey, vector<Point> > paths;
+                std::mutex pathsMutex;
+                auto start = std::chrono::steady_clock::now();
+                pool.ParallelFor(0, static_cast<int>(importantPoints.size()), 1, [&](int i) {
+                    BFS(grid, importantPoints[i].first, importantPoints[i].second, importantPoints, paths,
+                        pathsMutex);
+                });
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (bfsSeconds < 0 || seconds < bfsSeconds) {
+                    bfsSeconds = seconds;
+                }
+            }
+
+            GAOptions options;
+            options.maxGenerations = BENCHMARK_GA_GENERATIONS;
+            options.stopAtUpperBound = false;
+            options.pool = &pool;
+            auto start = std::chrono::steady_clock::now();
+            MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+            double gaSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Speedups are against the first row, one floating thread
+            if (baseBFSSeconds == 0) {
+                baseBFSSeconds = bfsSeconds;
+                baseGASeconds = gaSeconds;
+            }
+            printf("%-15s %8u %12.2f %12.2f %14.1f %12.2f\n", layoutNames[layout], threads, bfsSeconds * 1e3,
+                   baseBFSSeconds / bfsSeconds, gaSeconds * 1e3, baseGASeconds / gaSeconds);
+        }
+    }
+}
+
+void RunBenchmarks(char **grid, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                   const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                   HostageStation **hostageStations, double targetFitness) {
+    if (pathsBetweenStations.empty() || importantPoints.size() < 2 || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: RunBenchmarks received invalid parameters\n");
+        return;
+    }
+
+    // Randomized insertion gives different valid plans, like the ones in a GA population
+    DistanceMatrix distances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+    std::mt19937 rng(BENCHMARK_PLANS);
+    vector<vector<vector<LocationID> > > plans;
+    for (int p = 0; p < BENCHMARK_PLANS; ++p) {
+        plans.push_back(ConstructPlan(distances, importantPoints, numOfUnits, hostageStations, UNIT_STEP_BUDGET,
+                                      CHEAPEST_INSERTION, RANDOM_CONSTRUCTION_CANDIDATES, rng));
+    }
+
+    BenchmarkSchedulers(pathsBetweenStations, plans, hostageStations, std::thread::hardware_concurrency());
+    BenchmarkQueueBackends(std::thread::hardware_concurrency());
+    BenchmarkParallelRegion(pathsBetweenStations, importantPoints, numOfUnits, plans, hostageStations,
+                            std::thread::hardware_concurrency());
+    BenchmarkPriorities(pathsBetweenStations, plans, hostageStations, std::thread::hardware_concurrency());
+    BenchmarkTimeToTarget(pathsBetweenStations, importantPoints, numOfUnits, hostageStations,
+                          std::thread::hardware_concurrency(), targetFitness);
+    BenchmarkScaling(grid, pathsBetweenStations, importantPoints, numOfUnits, hostageStations,
+                     std::thread::hardware_concurrency());
+}
@@ -0,0 +1,241 @@
+//----INCLUDES--------------------------------------------------------
+#include <cstdio>
+#include "include/Checkpoint.h"
+#include "include/Visualizer.h"
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+//----FUNCTIONS-------------------------------------------------------
+// The file is a flat list of fields in the order of GACheckpoint, vectors are written as a count and the items
+static bool WriteValue(FILE *file, const void *value, size_t size) {
+    return fwrite(value, size, 1, file) == 1;
+}
+
+static bool WriteInt(FILE *file, int32_t value) {
+    return WriteValue(file, &value, sizeof(value));
+}
+
+static bool WriteDouble(FILE *file, double value) {
+    return WriteValue(file, &value, sizeof(value));
+}
+
+template<typename T>
+static bool WriteVector(FILE *file, const vector<T> &values) {
+    uint32_t count = static_cast<uint32_t>(values.size());
+    if (!WriteValue(file, &count, sizeof(count))) {
+        return false;
+    }
+    return count == 0 || fwrite(values.data(), sizeof(T), count, file) == count;
+}
+
+static bool WritePlan(FILE *file, const vector<vector<LocationID> > &plan) {
+    uint32_t numOfUnits = static_cast<uint32_t>(plan.size());
+    if (!WriteValue(file, &numOfUnits, sizeof(numOfUnits))) {
+        return false;
+    }
+    for (const vector<LocationID> &unitPath: plan) {
+        if (!WriteVector(file, unitPath)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ReadValue(FILE *file, void *value, size_t size) {
+    return fread(value, size, 1, file) == 1;
+}
+
+static bool ReadInt(FILE *file, int &value) {
+    int32_t stored;
+    if (!ReadValue(file, &stored, sizeof(stored))) {
+        return false;
+    }
+    value = stored;
+    return true;
+}
+
+static bool ReadDouble(FILE *file, double &value) {
+    return ReadValue(file, &value, sizeof(value));
+}
+
+template<typename T>
+static bool ReadVector(FILE *file, vector<T> &values) {
+    uint32_t count;
+    if (!ReadValue(file, &count, sizeof(count)) || count > CHECKPOINT_MAX_COUNT) {
+        return false;
+    }
+    values.resize(count);
+    return count == 0 || fread(values.data(), sizeof(T), count, file) == count;
+}
+
+static bool ReadPlan(FILE *file, vector<vector<LocationID> > &plan) {
+    uint32_t numOfUnits;
+    if (!ReadValue(file, &numOfUnits, sizeof(numOfUnits)) || numOfUnits > CHECKPOINT_MAX_COUNT) {
+        return false;
+    }
+    plan.resize(numOfUnits);
+    for (vector<LocationID> &unitPath: plan) {
+        if (!ReadVector(file, unitPath)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool WriteCheckpoint(FILE *file, const GACheckpoint &checkpoint) {
+    uint32_t header[2] = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION};
+    if (!WriteValue(file, header, sizeof(header)) ||
+        !WriteValue(file, &checkpoint.scenarioHash, sizeof(checkpoint.scenarioHash)) ||
+        !WriteInt(file, checkpoint.generation) || !WriteInt(file, checkpoint.numOfUnits) ||
+        !WriteInt(file, checkpoint.stepBudget) || !WriteInt(file, checkpoint.stagnantGenerations) ||
+        !WriteDouble(file, checkpoint.lastBestFitness)) {
+        return false;
+    }
+
+    uint32_t populationSize = static_cast<uint32_t>(checkpoint.population.size());
+    if (!WriteValue(file, &populationSize, sizeof(populationSize))) {
+        return false;
+    }
+    for (const vector<vector<LocationID> > &chromosome: checkpoint.population) {
+        if (!WritePlan(file, chromosome)) {
+            return false;
+        }
+    }
+
+    vector<char> randomState(checkpoint.randomState.begin(), checkpoint.randomState.end());
+    return WriteVector(file, checkpoint.fitness) && WriteVector(file, checkpoint.isValid) &&
+           WriteVector(file, checkpoint.operatorQuality) && WriteVector(file, checkpoint.operatorProbability) &&
+           WriteVector(file, randomState) && WritePlan(file, checkpoint.bestPlan) &&
+           WriteDouble(file, checkpoint.bestFitness);
+}
+
+static bool ReadCheckpoint(FILE *file, GACheckpoint &checkpoint) {
+    uint32_t header[2];
+    if (!ReadValue(file, header, sizeof(header)) || header[0] != CHECKPOINT_MAGIC ||
+        header[1] != CHECKPOINT_VERSION) {
+        return false;
+    }
+    if (!ReadValue(file, &checkpoint.scenarioHash, sizeof(checkpoint.scenarioHash)) ||
+        !ReadInt(file, checkpoint.generation) || !ReadInt(file, checkpoint.numOfUnits) ||
+        !ReadInt(file, checkpoint.stepBudget) || !ReadInt(file, checkpoint.stagnantGenerations) ||
+        !ReadDouble(file, checkpoint.lastBestFitness)) {
+        return false;
+    }
+
+    uint32_t populationSize;
+    if (!ReadValue(file, &populationSize, sizeof(populationSize)) || populationSize > CHECKPOINT_MAX_COUNT) {
+        return false;
+    }
+    checkpoint.population.resize(populationSize);
+    for (vector<vector<LocationID> > &chromosome: checkpoint.population) {
+        if (!ReadPlan(file, chromosome)) {
+            return false;
+        }
+    }
+
+    vector<char> randomState;
+    if (!ReadVector(file, checkpoint.fitness) || !ReadVector(file, checkpoint.isValid) ||
+        !ReadVector(file, checkpoint.operatorQuality) || !ReadVector(file, checkpoint.operatorProbability) ||
+        !ReadVector(file, randomState) || !ReadPlan(file, checkpoint.bestPlan) ||
+        !ReadDouble(file, checkpoint.bestFitness)) {
+        return false;
+    }
+    checkpoint.randomState.assign(randomState.begin(), randomState.end());
+
+    // Every chromosome needs its fitness
+    return checkpoint.fitness.size() == populationSize && checkpoint.isValid.size() == populationSize;
+}
+
+bool SaveCheckpoint(const GACheckpoint &checkpoint, const std::string &path) {
+    if (path.empty()) {
+        PrintError("Error: SaveCheckpoint received an empty path\n");
+        return false;
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        PrintError("Error: SaveCheckpoint couldn't open %s\n", temporaryPath.c_str());
+        return false;
+    }
+    bool written = WriteCheckpoint(file, checkpoint);
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        PrintError("Error: SaveCheckpoint couldn't write %s\n", temporaryPath.c_str());
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // Replace the old checkpoint in one step, so there is always a whole one at the path.
+    // rename doesn't replace an existing file on Windows, MoveFileEx does.
+#if defined(_WIN32)
+    bool moved = MoveFileExA(temporaryPath.c_str(), path.c_str(),
+                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool moved = rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!moved) {
+        PrintError("Error: SaveCheckpoint couldn't move the checkpoint to %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadCheckpoint(GACheckpoint &checkpoint, const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool read = ReadCheckpoint(file, checkpoint);
+    fclose(file);
+    if (!read) {
+        PrintError("Error: LoadCheckpoint found a broken or old checkpoint in %s\n", path.c_str());
+    }
+    return read;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &path) : path_(path) {
+    thread_ = std::thread(&CheckpointWriter::Run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void CheckpointWriter::Submit(std::unique_ptr<GACheckpoint> checkpoint) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(checkpoint); // An older checkpoint still waiting is dropped here
+    }
+    cv_.notify_one();
+}
+
+int CheckpointWriter::GetWrittenCount() const {
+    return writtenCount_.load(std::memory_order_relaxed);
+}
+
+void CheckpointWriter::Run() {
+    while (true) {
+        std::unique_ptr<GACheckpoint> checkpoint;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || pending_ != nullptr; });
+            if (pending_ == nullptr) {
+                // Stopped and nothing left to write
+                return;
+            }
+            checkpoint = std::move(pending_);
+        }
+
+        // Write without the lock so the GA can hand over the next checkpoint meanwhile
+        if (SaveCheckpoint(*checkpoint, path_)) {
+            writtenCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,260 @@
+//----INCLUDES--------------------------------------------------------
+#include <algorithm>
+#include <climits>
+#include "include/Construction.h"
+#include "include/Visualizer.h"
+
+//----STRUCT------------------------------------------------------
+// The best place found for an unused station
+struct Insertion {
+    LocationID station = -1;
+    int unit = -1;
+    int position = -1;
+    double score = 0; // Higher is inserted first
+    double value = 0; // PValue per added step, breaks score ties
+};
+
+//----FUNCTIONS-------------------------------------------------------
+// Find the cheapest position of the station in the unit path, return its cost or -1 if it doesn't fit the budget
+static int CheapestPosition(const vector<LocationID> &path, int pathSteps, LocationID station,
+                            const DistanceMatrix &distances, int stepBudget, int &bestPosition) {
+    int bestCost = -1;
+    for (int position = 1; position <= path.size(); ++position) {
+        int cost = InsertionCost(path, position, station, distances);
+        if (pathSteps + cost <= stepBudget && (bestCost == -1 || cost < bestCost)) {
+            bestCost = cost;
+            bestPosition = position;
+        }
+    }
+    return bestCost;
+}
+
+// Score the insertion of one station by the rule, return false if it fits in no unit
+static bool ScoreInsertion(const vector<vector<LocationID> > &plan, const vector<int> &unitSteps, LocationID station,
+                           double pValue, const DistanceMatrix &distances, int stepBudget, InsertionRule rule,
+                           Insertion &insertion) {
+    // PValue per added step in each unit, 0 where the station doesn't fit
+    vector<double> unitValues;
+    insertion.station = station;
+    insertion.unit = -1;
+
+    for (int u = 0; u < plan.size(); ++u) {
+        int position = -1;
+        int cost = CheapestPosition(plan[u], unitSteps[u], station, distances, stepBudget, position);
+        if (cost == -1) {
+            unitValues.push_back(0);
+            continue;
+        }
+
+        double value = pValue / std::max(cost, 1);
+        unitValues.push_back(value);
+        if (insertion.unit == -1 || value > insertion.value) {
+            insertion.unit = u;
+            insertion.position = position;
+            insertion.value = value;
+        }
+    }
+    if (insertion.unit == -1) {
+        return false;
+    }
+
+    if (rule == CHEAPEST_INSERTION) {
+        insertion.score = insertion.value;
+    } else {
+        // Regret: what is lost by sending the station to each of its next best units instead
+        int k = std::min(REGRET_K, static_cast<int>(unitValues.size()));
+        std::partial_sort(unitValues.begin(), unitValues.begin() + k, unitValues.end(), std::greater<double>());
+        insertion.score = 0;
+        for (int j = 1; j < k; ++j) {
+            insertion.score += unitValues[0] - unitValues[j];
+        }
+    }
+    return true;
+}
+
+static bool IsBetterInsertion(const Insertion &a, const Insertion &b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.value > b.value;
+}
+
+void CompletePlan(vector<vector<LocationID> > &plan, const DistanceMatrix &distances,
+                  const vector<pair<LocationID, Point> > &importantPoints, HostageStation **hostageStations,
+                  int stepBudget, InsertionRule rule, int numOfCandidates, std::mt19937 &rng) {
+    if (hostageStations == nullptr || importantPoints.empty() || numOfCandidates < 1) {
+        PrintError("Error: CompletePlan received invalid parameters\n");
+        return;
+    }
+
+    vector<int> unitSteps(plan.size());
+    vector<bool> inPlan(MAX_STATIONS, false);
+    for (int u = 0; u < plan.size(); ++u) {
+        if (plan[u].empty()) {
+            PrintError("Error: CompletePlan received a path with not a set entrance\n");
+            return;
+        }
+        unitSteps[u] = PathDistance(plan[u], distances);
+        for (int s = 1; s < plan[u].size(); ++s) {
+            inPlan[plan[u][s]] = true;
+        }
+    }
+
+    vector<Insertion> candidates;
+    while (true) {
+        // Score every station that isn't in the plan yet
+        candidates.clear();
+        for (int i = 1; i < importantPoints.size(); ++i) {
+            LocationID station = importantPoints[i].first;
+            if (inPlan[station]) {
+                continue;
+            }
+
+            Insertion insertion;
+            if (ScoreInsertion(plan, unitSteps, station, hostageStations[station]->GetPValue(), distances,
+                               stepBudget, rule, insertion)) {
+                candidates.push_back(insertion);
+            }
+        }
+        if (candidates.empty()) {
+            // Nothing else fits
+            break;
+        }
+
+        // Take one of the best candidates
+        int numToConsider = std::min(numOfCandidates, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + numToConsider, candidates.end(),
+                          IsBetterInsertion);
+        const Insertion &chosen = candidates[numToConsider == 1 ? 0 : rng() % numToConsider];
+
+        vector<LocationID> &path = plan[chosen.unit];
+        unitSteps[chosen.unit] += InsertionCost(path, chosen.position, chosen.station, distances);
+        path.insert(path.begin() + chosen.position, chosen.station);
+        inPlan[chosen.station] = true;
+    }
+}
+
+vector<vector<LocationID> > ConstructPlan(const DistanceMatrix &distances,
+                                          const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                          HostageStation **hostageStations, int stepBudget, InsertionRule rule,
+                                          int numOfCandidates, std::mt19937 &rng) {
+    if (importantPoints.empty() || numOfUnits < 1) {
+        PrintError("Error: ConstructPlan received invalid parameters\n");
+        return vector<vector<LocationID> >();
+    }
+
+    // Every unit starts at the entrance
+    vector<vector<LocationID> > plan(numOfUnits, vector<LocationID>(1, importantPoints[0].first));
+    CompletePlan(plan, distances, importantPoints, hostageStations, stepBudget, rule, numOfCandidates, rng);
+    return plan;
+}
+
+vector<vector<LocationID> > RepairPlan(const vector<vector<LocationID> > &plan, const DistanceMatrix &distances,
+                                       const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                       HostageStation **hostageStations, int stepBudget) {
+    if (importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: RepairPlan received invalid parameters\n");
+        return vector<vector<LocationID> >();
+    }
+
+    // Only stations that are still important can stay
+    vector<bool> available(MAX_STATIONS, false);
+    for (int i = 1; i < importantPoints.size(); ++i) {
+        available[importantPoints[i].first] = true;
+    }
+
+    LocationID entrance = importantPoints[0].first;
+    vector<vector<LocationID> > repairedPlan(numOfUnits, vector<LocationID>(1, entrance));
+    for (int u = 0; u < numOfUnits && u < plan.size(); ++u) {
+        for (int s = 1; s < plan[u].size(); ++s) {
+            LocationID station = plan[u][s];
+            if (station >= 0 && station < MAX_STATIONS && available[station]) {
+                repairedPlan[u].push_back(station);
+                available[station] = false; // Taken, so a repeated station is dropped
+            }
+        }
+    }
+
+    // Cut the routes down to the budget, giving up the station worth the least per step it costs
+    for (vector<LocationID> &path: repairedPlan) {
+        int steps = PathDistance(path, distances);
+        while (path.size() > 1 && (steps == -1 || steps > stepBudget)) {
+            int worstIndex = 1;
+            double worstValue = 0;
+            for (int s = 1; s < path.size(); ++s) {
+                double value = hostageStations[path[s]]->GetPValue() / std::max(RemovalGain(path, s, distances), 1);
+                if (s == 1 || value < worstValue) {
+                    worstValue = value;
+                    worstIndex = s;
+                }
+            }
+            path.erase(path.begin() + worstIndex);
+            steps = PathDistance(path, distances);
+        }
+    }
+
+    // Use the budget that got free (or was added) for new stations
+    std::mt19937 rng;
+    CompletePlan(repairedPlan, distances, importantPoints, hostageStations, stepBudget, CHEAPEST_INSERTION, 1, rng);
+    return repairedPlan;
+}
+
+// Total PValue of the stations in the plan
+static double PlanPValue(const vector<vector<LocationID> > &plan, HostageStation **hostageStations) {
+    double sum = 0;
+    for (const vector<LocationID> &path: plan) {
+        for (int s = 1; s < path.size(); ++s) {
+            sum += hostageStations[path[s]]->GetPValue();
+        }
+    }
+    return sum;
+}
+
+vector<vector<LocationID> > FastPlan(const DistanceMatrix &distances,
+                                     const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                     HostageStation **hostageStations, int stepBudget) {
+    if (importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: FastPlan received invalid parameters\n");
+        return vector<vector<LocationID> >();
+    }
+
+    // Deterministic, the random engine is never used with a single candidate
+    std::mt19937 rng;
+    vector<vector<LocationID> > bestPlan;
+    double bestPValue = -1;
+
+    InsertionRule rules[] = {CHEAPEST_INSERTION, REGRET_INSERTION};
+    for (InsertionRule rule: rules) {
+        vector<vector<LocationID> > plan = ConstructPlan(distances, importantPoints, numOfUnits, hostageStations,
+                                                         stepBudget, rule, 1, rng);
+
+        // Ordering the routes frees steps, keep refilling until the plan stops growing
+        int planSize;
+        do {
+            planSize = 0;
+            for (vector<LocationID> &path: plan) {
+                OrderPath(path, distances);
+                planSize += path.size();
+            }
+            CompletePlan(plan, distances, importantPoints, hostageStations, stepBudget, rule, 1, rng);
+            for (const vector<LocationID> &path: plan) {
+                planSize -= path.size();
+            }
+        } while (planSize != 0);
+
+        double pValue = PlanPValue(plan, hostageStations);
+        if (pValue > bestPValue) {
+            bestPValue = pValue;
+            bestPlan.swap(plan);
+        }
+    }
+
+    return bestPlan;
+}
+
+vector<vector<LocationID> > FastPlan(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                     const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                     HostageStation **hostageStations, int stepBudget) {
+    DistanceMatrix distances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+    return FastPlan(distances, importantPoints, numOfUnits, hostageStations, stepBudget);
+}
@@ -0,0 +1,123 @@
+//----INCLUDES--------------------------------------------------------
+#include <cstdio>
+#include "include/CpuTopology.h"
+#include "include/Visualizer.h"
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//----FUNCTIONS-------------------------------------------------------
+#if defined(_WIN32)
+// First logical core of the physical core that has the given logical core, -1 if unknown
+static int FirstSmtSibling(int core) {
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (info.empty() || !GetLogicalProcessorInformation(info.data(), &length)) {
+        return -1;
+    }
+    for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION &entry: info) {
+        if (entry.Relationship == RelationProcessorCore && (entry.ProcessorMask >> core & 1) != 0) {
+            for (int sibling = 0; sibling < 64; ++sibling) {
+                if ((entry.ProcessorMask >> sibling & 1) != 0) {
+                    return sibling;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+std::vector<int> GetUsableCores(bool skipSmtSiblings) {
+    // Only the processor group of the process, which covers up to 64 cores
+    DWORD_PTR processMask;
+    DWORD_PTR systemMask;
+    std::vector<int> cores;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        PrintWarning("Warning: GetUsableCores couldn't read the affinity of the process\n");
+        return cores;
+    }
+    for (int core = 0; core < 64; ++core) {
+        if ((processMask >> core & 1) != 0 && (!skipSmtSiblings || FirstSmtSibling(core) == core)) {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+bool PinThreadToCore(std::thread &thread, int core) {
+    if (core < 0 || core >= 64) {
+        PrintError("Error: PinThreadToCore received invalid core %d\n", core);
+        return false;
+    }
+    return SetThreadAffinityMask(static_cast<HANDLE>(thread.native_handle()), DWORD_PTR(1) << core) != 0;
+}
+
+#elif defined(__linux__)
+// First logical core of the physical core that has the given logical core, -1 if unknown
+static int FirstSmtSibling(int core) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", core);
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    // The list is like "3,67" or "2-3", it starts with the lowest sibling
+    int sibling = -1;
+    if (fscanf(file, "%d", &sibling) != 1) {
+        sibling = -1;
+    }
+    fclose(file);
+    return sibling;
+}
+
+std::vector<int> GetUsableCores(bool skipSmtSiblings) {
+    cpu_set_t set;
+    std::vector<int> cores;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        PrintWarning("Warning: GetUsableCores couldn't read the affinity of the process\n");
+        return cores;
+    }
+    for (int core = 0; core < CPU_SETSIZE; ++core) {
+        if (!CPU_ISSET(core, &set)) {
+            continue;
+        }
+        // A core without topology info counts as its own physical core
+        int sibling = skipSmtSiblings ? FirstSmtSibling(core) : core;
+        if (sibling == core || sibling == -1) {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+bool PinThreadToCore(std::thread &thread, int core) {
+    if (core < 0 || core >= CPU_SETSIZE) {
+        PrintError("Error: PinThreadToCore received invalid core %d\n", core);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+#else
+std::vector<int> GetUsableCores(bool skipSmtSiblings) {
+    std::vector<int> cores;
+    for (int core = 0; core < static_cast<int>(std::thread::hardware_concurrency()); ++core) {
+        cores.push_back(core);
+    }
+    return cores;
+}
+
+bool PinThreadToCore(std::thread &thread, int core) {
+    // No affinity API here, the threads stay where the OS puts them
+    return false;
+}
+#endif
@@ -0,0 +1,76 @@
+//----INCLUDES--------------------------------------------------------
+#include <cstring>
+#include "include/FitnessCache.h"
+
+//----FUNCTIONS-------------------------------------------------------
+FitnessCache::FitnessCache(int sizeBits) : slots_(new Slot[1ull << sizeBits]), mask_((1ull << sizeBits) - 1) {
+}
+
+bool FitnessCache::Lookup(uint64_t key, double &fitness) const {
+    key = FixKey(key);
+
+    for (int probe = 0; probe < FITNESS_CACHE_PROBES; ++probe) {
+        const Slot &slot = slots_[(key + probe) & mask_];
+        if (slot.key.load(std::memory_order_acquire) != key) {
+            continue;
+        }
+
+        uint64_t bits = slot.fitnessBits.load(std::memory_order_relaxed);
+
+        // Make sure no writer took the slot while we read the value
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.key.load(std::memory_order_relaxed) != key) {
+            return false;
+        }
+
+        memcpy(&fitness, &bits, sizeof(fitness));
+        return true;
+    }
+
+    return false;
+}
+
+void FitnessCache::Insert(uint64_t key, double fitness) {
+    key = FixKey(key);
+    uint64_t bits;
+    memcpy(&bits, &fitness, sizeof(bits));
+
+    // Look for the key or a free slot in the probe window, remember the first slot to overwrite if there is neither
+    Slot *target = nullptr;
+    uint64_t expected = EMPTY_KEY;
+    for (int probe = 0; probe < FITNESS_CACHE_PROBES; ++probe) {
+        Slot &slot = slots_[(key + probe) & mask_];
+        uint64_t current = slot.key.load(std::memory_order_relaxed);
+        if (current == key) {
+            // Already cached
+            return;
+        }
+        if (current == EMPTY_KEY) {
+            target = &slot;
+            expected = EMPTY_KEY;
+            break;
+        }
+        if (target == nullptr && current != BUSY_KEY) {
+            target = &slot;
+            expected = current;
+        }
+    }
+    if (target == nullptr) {
+        // Every slot is being written, skip
+        return;
+    }
+
+    // Seqlock style: the slot key is the lock and the version. The writer marks the slot BUSY_KEY, writes the value
+    // and publishes the new key with release. A reader loads the key with acquire, then the value, then the key
+    // again after an acquire fence, and only trusts the value if the key didn't change.
+    // Take the slot, if another thread got it first just skip this insert
+    if (!target->key.compare_exchange_strong(expected, BUSY_KEY, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    // Orders BUSY_KEY before the new value, so a reader that sees the new value also sees the slot was taken when
+    // it checks the key again, and doesn't pair the old key with it
+    std::atomic_thread_fence(std::memory_order_release);
+    target->fitnessBits.store(bits, std::memory_order_relaxed);
+    target->key.store(key, std::memory_order_release);
+}
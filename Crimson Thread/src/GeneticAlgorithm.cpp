@@ -1,13 +1,156 @@
 //----INCLUDES--------------------------------------------------------
 #include <stdlib.h>
 #include <cstdio>
-#include <set>
 #include <algorithm>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <sstream>
 # include "include/GeneticAlgorithm.h"
+#include "include/Checkpoint.h"
 #include "include/ThreadPool.h"
+#include "include/ParallelRegion.h"
+#include "include/RouteOptimizer.h"
+#include "include/FitnessCache.h"
+#include "include/Construction.h"
 #include "include/Visualizer.h"
 
+//----STRUCT------------------------------------------------------
+// Lock-free single-producer single-consumer ring that carries migrants from one island to its neighbour
+struct MigrationMailbox {
+    static const unsigned int CAPACITY = 16;
+    Chromosome *slots[CAPACITY] = {};
+    std::atomic<unsigned int> head{0}; // Next slot the consumer reads, only the consumer writes it
+    std::atomic<unsigned int> tail{0}; // Next slot the producer writes, only the producer writes it
+
+    // Called only by the sending island, returns false if the mailbox is full
+    bool Push(Chromosome *chromosome) {
+        unsigned int currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        slots[currentTail % CAPACITY] = chromosome;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called only by the receiving island, returns null if the mailbox is empty
+    Chromosome *Pop() {
+        unsigned int currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        Chromosome *chromosome = slots[currentHead % CAPACITY];
+        head.store(currentHead + 1, std::memory_order_release);
+        return chromosome;
+    }
+};
+
+// Counters of one population, copied into GAStats for the caller. The single population shares one set between
+// the pool threads, each island has its own so the islands don't fight over the cache lines.
+struct GACounters {
+    std::atomic<long long> evaluations{0};
+    std::atomic<long long> invalidEvaluations{0};
+    std::atomic<long long> cacheLookups{0};
+    std::atomic<long long> cacheHits{0};
+    // Indexed by MutationOperator
+    std::atomic<long long> operatorApplications[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<long long> operatorChanges[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<long long> operatorImprovements[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<long long> operatorAccepted[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<double> operatorGain[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<double> operatorSeconds[NUM_OF_MUTATION_OPERATORS] = {};
+    std::atomic<double> operatorProbability[NUM_OF_MUTATION_OPERATORS] = {};
+};
+
+// Probability matching over the mutation operators, each population owns one so it needs no locking.
+// The quality of an operator is the fitness it gained per second spent in it, its chance follows its quality.
+struct OperatorSelector {
+    bool enabled[NUM_OF_MUTATION_OPERATORS] = {}; // Operators the run may pick, the rest keep a zero probability
+    double quality[NUM_OF_MUTATION_OPERATORS] = {};
+    double probability[NUM_OF_MUTATION_OPERATORS] = {};
+    double generationGain[NUM_OF_MUTATION_OPERATORS] = {}; // Collected since the last update
+    double generationSeconds[NUM_OF_MUTATION_OPERATORS] = {};
+};
+
+// Shared between the GA loop and all the islands, decides when the run ends
+struct GARunState {
+    const GAOptions *options = nullptr;
+    std::chrono::steady_clock::time_point start;
+    double upperBound = 0;
+    BestPlanTracker *bestSoFar = nullptr;
+    std::atomic<bool> stop{false};
+    std::atomic<double> secondsToTarget{-1}; // Set by the first thread that sees options->targetFitness reached
+    GACounters counters; // Counters of the single population
+    vector<std::unique_ptr<GACounters> > islandCounters; // One set per island, set up before the islands start
+    FitnessCache fitnessCache; // Shared by all the islands, a plan evaluated by one is known to the rest
+    const vector<vector<LocationID> > *warmStartPlan = nullptr; // Repaired previous plan when replanning
+    NeighbourLists neighbours; // Candidate stations of the neighbour mutations
+    const GACheckpoint *resumeFrom = nullptr; // Saved run to continue instead of creating generation 0
+    uint64_t scenarioHash = 0; // Saved with the checkpoints
+};
+
+// The state of one island, only the mailboxes and the run state are shared with other threads
+struct Island {
+    int index = 0;
+    int populationSize = 0;
+    GARunState *runState = nullptr;
+    MigrationMailbox *inbox = nullptr;
+    MigrationMailbox *outbox = nullptr;
+    GACounters *counters = nullptr; // Only this island writes them
+    Chromosome *best = nullptr; // Copy of the fittest chromosome, set when the island finishes
+};
+
 //----FUNCTIONS-------------------------------------------------------
+bool BestPlanTracker::Offer(const vector<vector<LocationID> > &plan, double fitness, PlanEngine engine) {
+    // Cheap check first so the GA threads rarely take the lock
+    if (fitness <= fitness_.load()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fitness <= fitness_.load()) {
+        return false;
+    }
+    plan_ = plan;
+    engine_ = engine;
+    fitness_.store(fitness);
+    return true;
+}
+
+vector<vector<LocationID> > BestPlanTracker::GetPlan() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return plan_;
+}
+
+double BestPlanTracker::GetFitness() const {
+    return fitness_.load();
+}
+
+PlanEngine BestPlanTracker::GetEngine() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return engine_;
+}
+
+// Get the engine owned by the calling thread, so islands never share state
+std::mt19937 &RandomEngine() {
+    static std::atomic<unsigned int> threadCounter{0};
+    static thread_local std::mt19937 randomEngine(std::random_device{}() + threadCounter++);
+    return randomEngine;
+}
+
+// Get a random non-negative int from the engine of the calling thread
+int RandomInt() {
+    return static_cast<int>(RandomEngine()() & 0x7fffffff);
+}
+
+// std::atomic<double> has no fetch_add before C++20
+void AtomicAdd(std::atomic<double> &value, double amount) {
+    double current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+    }
+}
+
 int GetPathCost(LocationID id1, LocationID id2, const map<PathKey, vector<Point> > &pathsBetweenStations) {
     PathKey key = MakeKey(id1, id2);
     auto it = pathsBetweenStations.find(key);
@@ -41,39 +184,21 @@ double SumPValue(const vector<vector<LocationID> > plan, HostageStation **hostag
     return sum;
 }
 
-int PathDistance(vector<LocationID> path, const map<PathKey, vector<Point> > &pathsBetweenStations) {
-    if (path.empty()) {
-        PrintWarning("Warning: PathDistance received an empty path");
-    }
-
-    int pathLength = 0;
-
-    // Sum the total distance between each Point in the unit path
-    for (int s = 1; s < path.size(); ++s) {
-        int segmentLength = GetPathCost(path[s - 1], path[s], pathsBetweenStations);
-        if (segmentLength == -1) {
-            PrintError("Error: PathDistance searched invalid path segment from %d to %d", s - 1, s);
-            return -1;
-        }
-        pathLength += segmentLength;
-    }
-
-    return pathLength;
-}
-
-bool IsValidPath(vector<LocationID> &unitPath, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+bool IsValidPath(vector<LocationID> &unitPath, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                 int stepBudget) {
     if (unitPath.empty()) {
         return false;
     }
-    // A set to store encountered LocationIDs
-    std::set<LocationID> encounteredStations;
+    // Stations already seen on the path, a bit test replaces the set lookup
+    StationSet encounteredStations;
     int pathLength = 0;
 
     for (int s = 1; s < unitPath.size(); ++s) {
-        if (!encounteredStations.insert(unitPath[s]).second) {
-            // If insert second is false, it means the station was in the set before.
+        if (encounteredStations.test(unitPath[s])) {
+            // The station was visited before.
             return false;
         }
+        encounteredStations.set(unitPath[s]);
 
         // Sum path
         int segmentLength = GetPathCost(unitPath[s - 1], unitPath[s], pathsBetweenStations);
@@ -83,7 +208,7 @@ bool IsValidPath(vector<LocationID> &unitPath, const map<PathKey, vector<Point>
         }
         pathLength += segmentLength;
 
-        if (pathLength > UNIT_STEP_BUDGET) {
+        if (pathLength > stepBudget) {
             return false; // The unit has passed the budget
         }
     }
@@ -91,7 +216,8 @@ bool IsValidPath(vector<LocationID> &unitPath, const map<PathKey, vector<Point>
     return true;
 }
 
-bool IsValidChromosome(Chromosome *chromosome, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+bool IsValidChromosome(Chromosome *chromosome, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                       int stepBudget) {
     if (!chromosome) {
         PrintError("Error: IsValid received null chromosome\n");
         return false;
@@ -100,18 +226,19 @@ bool IsValidChromosome(Chromosome *chromosome, const map<PathKey, vector<Point>
         PrintError("Error: IsValidChromosome received chromosome with mismatch unitPaths and unitSteps size");
     }
 
-    // A set to store encountered LocationIDs
-    std::set<LocationID> encounteredStations;
+    // Stations already seen in any of the paths, a bit test replaces the set lookup
+    StationSet encounteredStations;
     int pathLength = 0;
 
     int i = 0;
 
-    for (vector<LocationID> unitPath: chromosome->unitPaths) {
+    for (const vector<LocationID> &unitPath: chromosome->unitPaths) {
         for (int s = 1; s < unitPath.size(); ++s) {
-            if (!encounteredStations.insert(unitPath[s]).second) {
-                // If insert second is false, it means the station was in the set before.
+            if (encounteredStations.test(unitPath[s])) {
+                // The station was visited before.
                 return false;
             }
+            encounteredStations.set(unitPath[s]);
 
             // Sum path
             int segmentLength = GetPathCost(unitPath[s - 1], unitPath[s], pathsBetweenStations);
@@ -121,7 +248,7 @@ bool IsValidChromosome(Chromosome *chromosome, const map<PathKey, vector<Point>
             }
             pathLength += segmentLength;
 
-            if (pathLength > UNIT_STEP_BUDGET) {
+            if (pathLength > stepBudget) {
                 return false; // One of the units has passed the budget
             }
         }
@@ -199,10 +326,6 @@ Chromosome *GetFittestChromosome(Chromosome **chromosomeArray, int population) {
     return fittest;
 }
 
-Chromosome *GetFittestChromosome(Chromosome **chromosomeArray) {
-    return GetFittestChromosome(chromosomeArray, POPULATION_SIZE);
-}
-
 // Creat new empty chromosome
 Chromosome *AllocateChromosome(int numOfUnits) {
     if (numOfUnits <= 0) {
@@ -225,15 +348,15 @@ Chromosome *AllocateChromosome(int numOfUnits) {
 }
 
 // Allocate the full population of chromosomes
-Chromosome **AllocateChromosomePopulation(int numOfUnits) {
+Chromosome **AllocateChromosomePopulation(int numOfUnits, int populationSize) {
     if (numOfUnits <= 0) {
         PrintError("Error: AllocateChromosome received nun-positive amount of units\n");
         return nullptr;
     }
 
     try {
-        Chromosome **chromosomeArray = new Chromosome *[POPULATION_SIZE];
-        for (int i = 0; i < POPULATION_SIZE; i++) {
+        Chromosome **chromosomeArray = new Chromosome *[populationSize];
+        for (int i = 0; i < populationSize; i++) {
             chromosomeArray[i] = AllocateChromosome(numOfUnits);
             if (chromosomeArray[i] == nullptr) {
                 PrintError("Error: AllocateChromosome failed to allocate chromosome in the array\n");
@@ -253,13 +376,13 @@ Chromosome **AllocateChromosomePopulation(int numOfUnits) {
 }
 
 // Deallocate the full population of chromosomes
-void DeallocateChromosomePopulation(Chromosome **chromosomeArray) {
+void DeallocateChromosomePopulation(Chromosome **chromosomeArray, int populationSize) {
     if (chromosomeArray == nullptr) {
         PrintWarning("Warning: DeallocateChromosomePopulation received a null chromosomeArray\n");
         return;
     }
 
-    for (int i = 0; i < POPULATION_SIZE; i++) {
+    for (int i = 0; i < populationSize; i++) {
         delete chromosomeArray[i];
     }
     delete[] chromosomeArray;
@@ -304,6 +427,54 @@ void InsertStationToPath(Chromosome *chromosome, int unit, LocationID station,
 
     chromosome->unitSteps[unit] += segmentLength;
     chromosome->unitPaths[unit].push_back(station);
+    chromosome->usedStations.set(station);
+}
+
+// Recalculate how many steps each unit takes using the distance matrix
+void UpdateUnitSteps(Chromosome *chromosome, const DistanceMatrix &distances) {
+    if (chromosome == nullptr) {
+        PrintError("Error: UpdateUnitSteps received null chromosome\n");
+        return;
+    }
+
+    chromosome->unitSteps.resize(chromosome->unitPaths.size());
+    for (int u = 0; u < chromosome->unitPaths.size(); ++u) {
+        chromosome->unitSteps[u] = PathDistance(chromosome->unitPaths[u], distances);
+    }
+}
+
+// Recalculate which stations the chromosome uses after its paths were replaced
+void RebuildStationUsage(Chromosome *chromosome) {
+    if (chromosome == nullptr) {
+        PrintError("Error: RebuildStationUsage received null chromosome\n");
+        return;
+    }
+
+    chromosome->usedStations.reset();
+    for (const vector<LocationID> &unitPath: chromosome->unitPaths) {
+        for (int s = 1; s < unitPath.size(); ++s) {
+            chromosome->usedStations.set(unitPath[s]);
+        }
+    }
+}
+
+// Get the stations of importantPoints as a set
+StationSet GetAllStations(const vector<pair<LocationID, Point> > &importantPoints) {
+    StationSet allStations;
+    for (int i = 1; i < importantPoints.size(); ++i) {
+        allStations.set(importantPoints[i].first);
+    }
+    return allStations;
+}
+
+// Get the ID of the n-th (from 0) station in the set, -1 if the set is smaller
+LocationID SelectStation(const StationSet &stations, int n) {
+    for (LocationID station = 0; station < MAX_STATIONS; ++station) {
+        if (stations.test(station) && n-- == 0) {
+            return station;
+        }
+    }
+    return -1;
 }
 
 void ResetAvailable(vector<int> *availableStations, const vector<pair<LocationID, Point> > &importantPoints) {
@@ -323,7 +494,7 @@ void ResetAvailable(vector<int> *availableStations, const vector<pair<LocationID
 
 // Check if we can reach the Point within the budget limit.
 bool IsReachable(Chromosome *chromosome, int unit, LocationID station,
-                 const map<PathKey, vector<Point> > &pathsBetweenStations) {
+                 const map<PathKey, vector<Point> > &pathsBetweenStations, int stepBudget) {
     if (chromosome == nullptr) {
         PrintError("Error: IsReachable received null chromosome\n");
         return false;
@@ -340,7 +511,7 @@ bool IsReachable(Chromosome *chromosome, int unit, LocationID station,
     int pathCost = GetPathCost(chromosome->unitPaths[unit].back(), station, pathsBetweenStations);
 
     // Check if getting to the Point will exceed the budget
-    return (chromosome->unitSteps[unit] + pathCost) <= UNIT_STEP_BUDGET && pathCost != -1;
+    return (chromosome->unitSteps[unit] + pathCost) <= stepBudget && pathCost != -1;
 }
 
 // Function to print unit paths
@@ -389,8 +560,9 @@ void PrintChromosomeInfo(const Chromosome *chromosome, int chromosomeIndex) {
     PrintUnitSteps(chromosome->unitSteps);
 }
 
-bool Initialization(Chromosome **chromosomeArray, const map<PathKey, vector<Point> > &pathsBetweenStations,
-                    const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits) {
+bool Initialization(Chromosome **chromosomeArray, int populationSize,
+                    const map<PathKey, vector<Point> > &pathsBetweenStations,
+                    const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits, int stepBudget) {
     if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1) {
         PrintError("Error: Initialization received in valid input");
         return false;
@@ -399,7 +571,7 @@ bool Initialization(Chromosome **chromosomeArray, const map<PathKey, vector<Poin
     // Initialize available stations
     vector<int> availableStations;
 
-    for (int c = 0; c < POPULATION_SIZE; c++) {
+    for (int c = 0; c < populationSize; c++) {
         if (chromosomeArray[c] == nullptr) {
             PrintError("Error: Initialization received null chromosome at index: %d\n", c);
         }
@@ -417,10 +589,10 @@ bool Initialization(Chromosome **chromosomeArray, const map<PathKey, vector<Poin
         // Add stations to each unit
         int numAttemptsToAdd = 20;
         for (int i = 0; i < numAttemptsToAdd && !allStationsAssigned; i++) {
-            int u = rand() % numOfUnits;
-            int randomIndex = rand() % availableStations.size();
+            int u = RandomInt() % numOfUnits;
+            int randomIndex = RandomInt() % availableStations.size();
             int randomStation = availableStations[randomIndex];
-            if (IsReachable(chromosomeArray[c], u, randomStation, pathsBetweenStations)) {
+            if (IsReachable(chromosomeArray[c], u, randomStation, pathsBetweenStations, stepBudget)) {
                 InsertStationToPath(chromosomeArray[c], u, randomStation, pathsBetweenStations);
 
                 // Remove the station from the list of available once, using swap and pop
@@ -438,15 +610,77 @@ bool Initialization(Chromosome **chromosomeArray, const map<PathKey, vector<Poin
     return true;
 }
 
+// Replace part of generation 0 with plans from the insertion heuristics. The first two are the greedy plans
+// themselves, the rest pick randomly between the best insertions so the seeds don't all look the same.
+void SeedConstructedPlans(Chromosome **chromosomeArray, int populationSize, const DistanceMatrix &distances,
+                          const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                          HostageStation **hostageStations, int stepBudget) {
+    if (chromosomeArray == nullptr || hostageStations == nullptr) {
+        PrintError("Error: SeedConstructedPlans received null parameters\n");
+        return;
+    }
+
+    std::mt19937 rng(RandomInt());
+    int numToSeed = populationSize * CONSTRUCTED_POPULATION_RATE / 100;
+    for (int c = 0; c < numToSeed; ++c) {
+        Chromosome *chromosome = chromosomeArray[c];
+        InsertionRule rule = c % 2 == 0 ? CHEAPEST_INSERTION : REGRET_INSERTION;
+        int numOfCandidates = c < 2 ? 1 : RANDOM_CONSTRUCTION_CANDIDATES;
+
+        chromosome->unitPaths = ConstructPlan(distances, importantPoints, numOfUnits, hostageStations,
+                                              stepBudget, rule, numOfCandidates, rng);
+        UpdateUnitSteps(chromosome, distances);
+        RebuildStationUsage(chromosome);
+        chromosome->needsFitnessEvaluation = true;
+    }
+}
+
+// Build part of generation 0 around the previous plan: the plan itself, then copies with a few random stations
+// taken out and the freed budget filled again, so the search starts in the neighbourhood of the old answer.
+// Fills the chromosomes right after the constructed ones.
+void SeedFromPreviousPlan(Chromosome **chromosomeArray, int populationSize, const vector<vector<LocationID> > &plan,
+                          const DistanceMatrix &distances, const vector<pair<LocationID, Point> > &importantPoints,
+                          HostageStation **hostageStations, int stepBudget) {
+    if (chromosomeArray == nullptr || hostageStations == nullptr) {
+        PrintError("Error: SeedFromPreviousPlan received null parameters\n");
+        return;
+    }
+
+    std::mt19937 rng(RandomInt());
+    int first = populationSize * CONSTRUCTED_POPULATION_RATE / 100;
+    int last = std::min(populationSize, first + populationSize * WARM_START_POPULATION_RATE / 100);
+    for (int c = first; c < last; ++c) {
+        Chromosome *chromosome = chromosomeArray[c];
+        chromosome->unitPaths = plan;
+
+        if (c > first) {
+            int numToRemove = RandomInt() % WARM_START_MAX_REMOVED + 1;
+            for (int r = 0; r < numToRemove; ++r) {
+                vector<LocationID> &unitPath = chromosome->unitPaths[RandomInt() % chromosome->unitPaths.size()];
+                if (unitPath.size() > 1) {
+                    unitPath.erase(unitPath.begin() + RandomInt() % (unitPath.size() - 1) + 1);
+                }
+            }
+            InsertionRule rule = c % 2 == 0 ? CHEAPEST_INSERTION : REGRET_INSERTION;
+            CompletePlan(chromosome->unitPaths, distances, importantPoints, hostageStations, stepBudget, rule,
+                         RANDOM_CONSTRUCTION_CANDIDATES, rng);
+        }
+
+        UpdateUnitSteps(chromosome, distances);
+        RebuildStationUsage(chromosome);
+        chromosome->needsFitnessEvaluation = true;
+    }
+}
+
 void CalculateFitness(Chromosome *chromosome, const map<PathKey, vector<Point> > &pathsBetweenStations,
-                      HostageStation **hostageStations) {
+                      int stepBudget, HostageStation **hostageStations, GACounters &counters) {
     if (chromosome == nullptr || hostageStations == nullptr) {
         PrintError("Error: CalculateFitness received null parameters\n");
         return;
     }
 
     // Check if valid chromosome
-    bool valid = IsValidChromosome(chromosome, pathsBetweenStations);
+    bool valid = IsValidChromosome(chromosome, pathsBetweenStations, stepBudget);
     chromosome->isValid = valid;
     // If not valid set a penalty fitness
     if (!valid) {
@@ -458,35 +692,152 @@ void CalculateFitness(Chromosome *chromosome, const map<PathKey, vector<Point> >
 
     // Mark the chromosome as evaluated
     chromosome->needsFitnessEvaluation = false;
+
+    counters.evaluations.fetch_add(1, std::memory_order_relaxed);
+    if (!valid) {
+        counters.invalidEvaluations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Spread the bits of a hash so close inputs end up far apart (splitmix64 finalizer)
+static uint64_t MixHash(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// Hash of the plan that doesn't depend on the order of the units, since swapping two units paths gives the
+// same plan. Each path is hashed by its station order and the path hashes are added together.
+uint64_t ChromosomeHash(const Chromosome *chromosome) {
+    uint64_t hash = 0;
+    for (const vector<LocationID> &unitPath: chromosome->unitPaths) {
+        // FNV-1a over the stations of the path, the order matters inside a path since it changes the steps
+        uint64_t pathHash = 0xcbf29ce484222325ull;
+        for (LocationID station: unitPath) {
+            pathHash ^= static_cast<uint64_t>(station + 2);
+            pathHash *= 0x100000001b3ull;
+        }
+        hash += MixHash(pathHash);
+    }
+    return MixHash(hash);
+}
+
+// FNV-1a step over the bytes of a value
+template<typename T>
+static void HashValue(uint64_t &hash, const T &value) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+    for (size_t b = 0; b < sizeof(value); ++b) {
+        hash ^= bytes[b];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+// Fingerprint of the stations, their PValues and the paths between them, a checkpoint is only used for the same one
+uint64_t ScenarioHash(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                      const vector<pair<LocationID, Point> > &importantPoints, HostageStation **hostageStations) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const pair<LocationID, Point> &point: importantPoints) {
+        HashValue(hash, point.first);
+        HashValue(hash, point.second.x);
+        HashValue(hash, point.second.y);
+        if (point.first >= 0) {
+            HashValue(hash, hostageStations[point.first]->GetPValue());
+        }
+    }
+    // The map is ordered, so the paths are always hashed in the same order
+    for (const auto &path: pathsBetweenStations) {
+        HashValue(hash, path.first.first);
+        HashValue(hash, path.first.second);
+        HashValue(hash, path.second.size());
+    }
+    return MixHash(hash);
+}
+
+// Take the fitness of an already seen plan from the cache, return if it was found
+bool ApplyCachedFitness(Chromosome *chromosome, uint64_t hash, const DistanceMatrix &distances, FitnessCache &cache,
+                        GACounters &counters) {
+    counters.cacheLookups.fetch_add(1, std::memory_order_relaxed);
+
+    double fitness;
+    if (!cache.Lookup(hash, fitness)) {
+        return false;
+    }
+    counters.cacheHits.fetch_add(1, std::memory_order_relaxed);
+
+    // The mutation operators rely on the steps of each unit, the matrix gives them without the map lookups
+    chromosome->fitness = fitness;
+    chromosome->isValid = fitness >= 0;
+    UpdateUnitSteps(chromosome, distances);
+    chromosome->needsFitnessEvaluation = false;
+    return true;
 }
 
-void EvaluatePopulationFitness(Chromosome **chromosomeArray, const map<PathKey, vector<Point> > &pathsBetweenStations,
-                               HostageStation **hostageStations, ThreadPool &pool) {
+// Evaluate a chromosome on the calling thread, using the cache if the plan was seen before
+void CalculateFitnessCached(Chromosome *chromosome, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                            const DistanceMatrix &distances, int stepBudget, HostageStation **hostageStations,
+                            FitnessCache &cache, GACounters &counters) {
+    uint64_t hash = ChromosomeHash(chromosome);
+    if (!ApplyCachedFitness(chromosome, hash, distances, cache, counters)) {
+        CalculateFitness(chromosome, pathsBetweenStations, stepBudget, hostageStations, counters);
+        cache.Insert(hash, chromosome->fitness);
+    }
+}
+
+// Same search as a parallel reduce over the pool, ties go to the lower index like the serial search
+Chromosome *GetFittestChromosome(Chromosome **chromosomeArray, int population, ThreadPool &pool) {
+    if (!chromosomeArray || population <= 0) {
+        PrintError("Error: GetFittestChromosome received invalid parameters\n");
+        return nullptr;
+    }
+
+    int fittestIndex = pool.ParallelReduce(0, population, PARALLEL_SEARCH_GRAIN, -1, [](int i) {
+        return i;
+    }, [chromosomeArray](int best, int candidate) {
+        if (candidate == -1 || chromosomeArray[candidate] == nullptr) {
+            return best;
+        }
+        if (best == -1 || chromosomeArray[candidate]->fitness > chromosomeArray[best]->fitness) {
+            return candidate;
+        }
+        return best;
+    });
+
+    return fittestIndex == -1 ? nullptr : chromosomeArray[fittestIndex];
+}
+
+void EvaluatePopulationFitness(Chromosome **chromosomeArray, int populationSize,
+                               const map<PathKey, vector<Point> > &pathsBetweenStations,
+                               const DistanceMatrix &distances, int stepBudget, HostageStation **hostageStations,
+                               ParallelRegion &region, FitnessCache &cache, GACounters &counters) {
     if (chromosomeArray == nullptr || hostageStations == nullptr) {
         PrintError("Error: EvaluatePopulationFitness received null parameters\n");
         return;
     }
 
-    // Iterate through each chromosome in the population.
-    for (int i = 0; i < POPULATION_SIZE; ++i) {
+    // Spread the population over the threads in chunks, this thread evaluates chunks too
+    region.ParallelFor(0, populationSize, 0, [&](int i) {
         if (chromosomeArray[i] == nullptr) {
             PrintWarning("Warning: EvaluatePopulationFitness recived null chromosme at index: %d", i);
         } else {
             // Check if the chromosome needs fitness evaluation.
             if (chromosomeArray[i]->needsFitnessEvaluation) {
-                // Use the thread pool to calculate to multiple chromosome their fitness.
-                pool.Enqueue([i, chromosomeArray, &pathsBetweenStations, hostageStations]() {
-                    CalculateFitness(chromosomeArray[i], pathsBetweenStations, hostageStations);
-                });
+                // Plans seen before don't need an evaluation at all
+                uint64_t hash = ChromosomeHash(chromosomeArray[i]);
+                if (ApplyCachedFitness(chromosomeArray[i], hash, distances, cache, counters)) {
+                    return;
+                }
+
+                CalculateFitness(chromosomeArray[i], pathsBetweenStations, stepBudget, hostageStations, counters);
+                cache.Insert(hash, chromosomeArray[i]->fitness);
             }
         }
-    }
-
-    // Wait for all submitted tasks to complete.
-    pool.WaitAll();
+    });
 }
 
-void Selection(Chromosome **chromosomeArray, Chromosome **matingPool) {
+void Selection(Chromosome **chromosomeArray, Chromosome **matingPool, int populationSize) {
     if (chromosomeArray == nullptr || matingPool == nullptr) {
         PrintError("Error: Selection received null parameters\n");
         return;
@@ -501,10 +852,10 @@ void Selection(Chromosome **chromosomeArray, Chromosome **matingPool) {
         return;
     }
 
-    for (int i = 0; i < POPULATION_SIZE; ++i) {
+    for (int i = 0; i < populationSize; ++i) {
         // Insert TOURNAMENT_SIZE random chromosomes into the arena
         for (int j = 0; j < TOURNAMENT_SIZE; ++j) {
-            arena[j] = chromosomeArray[rand() % POPULATION_SIZE];
+            arena[j] = chromosomeArray[RandomInt() % populationSize];
         }
         // Insert into the mating pool the fittest in the arena
         matingPool[i] = GetFittestChromosome(arena, TOURNAMENT_SIZE);
@@ -520,43 +871,114 @@ void Selection(Chromosome **chromosomeArray, Chromosome **matingPool) {
     delete arena;
 }
 
-void Crossover(Chromosome **matingPool, Chromosome **nextGeneration, int numOfUnits) {
+// Put each station at its cheapest place in any unit that has the budget for it, stations that fit nowhere are dropped
+void BestInsertStations(Chromosome *chromosome, const vector<LocationID> &stations, const DistanceMatrix &distances,
+                        int stepBudget) {
+    for (LocationID station: stations) {
+        int bestUnit = -1;
+        int bestPosition = -1;
+        int bestCost = 0;
+
+        for (int u = 0; u < chromosome->unitPaths.size(); ++u) {
+            const vector<LocationID> &unitPath = chromosome->unitPaths[u];
+            for (int position = 1; position <= unitPath.size(); ++position) {
+                int cost = InsertionCost(unitPath, position, station, distances);
+                if (chromosome->unitSteps[u] + cost <= stepBudget && (bestUnit == -1 || cost < bestCost)) {
+                    bestUnit = u;
+                    bestPosition = position;
+                    bestCost = cost;
+                }
+            }
+        }
+
+        if (bestUnit != -1) {
+            vector<LocationID> &unitPath = chromosome->unitPaths[bestUnit];
+            unitPath.insert(unitPath.begin() + bestPosition, station);
+            chromosome->unitSteps[bestUnit] += bestCost;
+            chromosome->usedStations.set(station);
+        }
+    }
+}
+
+// The child copies parent, but takes the path of unit from donor. The donor path stations are removed from the
+// other units (keeping their order), and the stations the child lost with the parent path are inserted back where
+// they fit best. The child never visits a station twice and every unit stays in budget if the parents were valid.
+void RouteExchangeCrossover(const Chromosome *parent, const Chromosome *donor, int unit, Chromosome *child,
+                            const DistanceMatrix &distances, int stepBudget) {
+    child->unitPaths = parent->unitPaths;
+    child->unitPaths[unit] = donor->unitPaths[unit];
+
+    StationSet donorStations;
+    for (int s = 1; s < donor->unitPaths[unit].size(); ++s) {
+        donorStations.set(donor->unitPaths[unit][s]);
+    }
+
+    // Remove the duplicates from the other units
+    for (int u = 0; u < child->unitPaths.size(); ++u) {
+        if (u == unit) {
+            continue;
+        }
+        vector<LocationID> &unitPath = child->unitPaths[u];
+        unitPath.erase(std::remove_if(unitPath.begin() + 1, unitPath.end(), [&donorStations](LocationID station) {
+            return donorStations.test(station);
+        }), unitPath.end());
+    }
+
+    UpdateUnitSteps(child, distances);
+    RebuildStationUsage(child);
+
+    // Give back the stations of the replaced path that no other unit has now
+    vector<LocationID> droppedStations;
+    for (int s = 1; s < parent->unitPaths[unit].size(); ++s) {
+        if (!child->usedStations.test(parent->unitPaths[unit][s])) {
+            droppedStations.push_back(parent->unitPaths[unit][s]);
+        }
+    }
+    BestInsertStations(child, droppedStations, distances, stepBudget);
+
+    // Mark for fitness recalculation
+    child->needsFitnessEvaluation = true;
+}
+
+void Crossover(Chromosome **matingPool, Chromosome **nextGeneration, int populationSize, int numOfUnits,
+               const DistanceMatrix &distances, int stepBudget) {
     if (!matingPool || !nextGeneration || numOfUnits < 1) {
         PrintError("Error: Crossover received invalid parameters\n");
         return;
     }
-    for (int i = 0; i < POPULATION_SIZE - 1; i += 2) {
+    for (int i = 0; i < populationSize - 1; i += 2) {
         // Save a pointer to two parent chromosomes
         Chromosome *parent1 = matingPool[i];
         Chromosome *parent2 = matingPool[i + 1];
         if (parent1 == nullptr || parent2 == nullptr) {
             PrintWarning("Error: Crossover received null chromosome in matingPool\n");
+            // Leave the slots empty, the callers skip null offspring
+            nextGeneration[i] = nullptr;
+            nextGeneration[i + 1] = nullptr;
         } else {
             // Creat new chromosomes to represent their offsprings
             Chromosome *child1 = AllocateChromosome(numOfUnits);
             Chromosome *child2 = AllocateChromosome(numOfUnits);
             if (child1 == nullptr || child2 == nullptr) {
                 PrintWarning("Error: Crossover received null chromosome during child allocation\n");
+                delete child1;
+                delete child2;
+                nextGeneration[i] = nullptr;
+                nextGeneration[i + 1] = nullptr;
             } else {
                 // Set the children paths and step count like their parents
                 child1->unitPaths = parent1->unitPaths;
                 child2->unitPaths = parent2->unitPaths;
                 child1->unitSteps = parent1->unitSteps;
                 child2->unitSteps = parent2->unitSteps;
-
-                if (rand() % 100 < CROSSOVER_RATE) {
-                    // Crossover occurs: Swap one paths' steps
-                    int randUnitIndex = rand() % numOfUnits;
-
-                    // Swap one unitPath and step count
-                    child1->unitPaths[randUnitIndex] = parent2->unitPaths[randUnitIndex];
-                    child1->unitSteps[randUnitIndex] = parent2->unitSteps[randUnitIndex];
-                    child2->unitPaths[randUnitIndex] = parent1->unitPaths[randUnitIndex];
-                    child2->unitSteps[randUnitIndex] = parent1->unitSteps[randUnitIndex];
-
-                    // Mark for fitness recalculation
-                    child1->needsFitnessEvaluation = true;
-                    child2->needsFitnessEvaluation = true;
+                child1->usedStations = parent1->usedStations;
+                child2->usedStations = parent2->usedStations;
+
+                if (RandomInt() % 100 < CROSSOVER_RATE) {
+                    // Crossover occurs: Each child takes one unit path from the other parent
+                    int randUnitIndex = RandomInt() % numOfUnits;
+                    RouteExchangeCrossover(parent1, parent2, randUnitIndex, child1, distances, stepBudget);
+                    RouteExchangeCrossover(parent2, parent1, randUnitIndex, child2, distances, stepBudget);
                 } else {
                     // No crossover: Simply copy the parents' entire data
                     child1->needsFitnessEvaluation = parent1->needsFitnessEvaluation;
@@ -583,39 +1005,22 @@ LocationID FindRandomUnusedStation(const Chromosome *chromosome,
         return -1;
     }
 
-    // Collect all used LocationIDs in the chromosome
-    std::set<LocationID> usedStations;
-    for (const vector<LocationID> &path: chromosome->unitPaths) {
-        for (const LocationID stationID: path) {
-            usedStations.insert(stationID);
-        }
-    }
-
-    // Collect all unused LocationIDs from the list of all possible stations
-    std::vector<LocationID> availableStations;
-    for (int i = 1; i < importantPoints.size(); ++i) {
-        // Check if the possible_station is NOT in the set of used_stations
-        if (usedStations.find(importantPoints[i].first) == usedStations.end()) {
-            // It's not in the used set, it's available
-            availableStations.push_back(importantPoints[i].first);
-        }
-    }
+    // The unused stations are the complement of the chromosome station set
+    StationSet availableStations = GetAllStations(importantPoints) & ~chromosome->usedStations;
 
     // Pick a random station from the available ones
-    if (availableStations.empty()) {
+    int numAvailable = availableStations.count();
+    if (numAvailable == 0) {
         // No unused stations available in this chromosome
         return -1;
     }
 
-    // Generate a random index within the bounds of the available_stations vector
-    int randomIndex = rand() % availableStations.size();
-
-    // Return the station at that random index
-    return availableStations[randomIndex];
+    return SelectStation(availableStations, RandomInt() % numAvailable);
 }
 
 bool AddStationToRandomUnitPath(Chromosome *chromosome, const vector<pair<LocationID, Point> > &importantPoints,
-                                int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+                                int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                int stepBudget) {
     if (chromosome == nullptr || importantPoints.empty() || numOfUnits < 1 || pathsBetweenStations.empty()) {
         PrintError("Error: AddStationToRandomUnitPath received invalid parameters\n");
         return false;
@@ -625,13 +1030,14 @@ bool AddStationToRandomUnitPath(Chromosome *chromosome, const vector<pair<Locati
         return false;
     }
     // Chose a random unit.
-    int randUnitIndex = rand() % numOfUnits;
+    int randUnitIndex = RandomInt() % numOfUnits;
 
     // Generate a random station ID that isn't assigned.
     int randomStation = FindRandomUnusedStation(chromosome, importantPoints);
 
     // Check if found and if so, is reachable.
-    if (randomStation != -1 && IsReachable(chromosome, randUnitIndex, randomStation, pathsBetweenStations)) {
+    if (randomStation != -1 &&
+        IsReachable(chromosome, randUnitIndex, randomStation, pathsBetweenStations, stepBudget)) {
         InsertStationToPath(chromosome, randUnitIndex, randomStation, pathsBetweenStations);
         // Return that the chromosome was mutated
         return true;
@@ -650,7 +1056,7 @@ bool RemoveStationFromRandomUnitPath(Chromosome *chromosome, int numOfUnits) {
         return false;
     }
     // Chose a random unit.
-    int randUnitIndex = rand() % numOfUnits;
+    int randUnitIndex = RandomInt() % numOfUnits;
 
     // Get a pointer to the unit assigned stations.
     vector<LocationID> &selectedPath = chromosome->unitPaths[randUnitIndex];
@@ -659,7 +1065,8 @@ bool RemoveStationFromRandomUnitPath(Chromosome *chromosome, int numOfUnits) {
     // Check if the unit has assigned stations.
     if (numberOfStops > 1) {
         // Chose a random station and remove it from the plan.
-        int randomStation = rand() % (numberOfStops - 1) + 1;
+        int randomStation = RandomInt() % (numberOfStops - 1) + 1;
+        chromosome->usedStations.reset(selectedPath[randomStation]);
         selectedPath.erase(selectedPath.begin() + randomStation);
 
         // Return that the chromosome was mutated.
@@ -671,7 +1078,8 @@ bool RemoveStationFromRandomUnitPath(Chromosome *chromosome, int numOfUnits) {
 }
 
 bool SwapStationFromRandomUnitPath(Chromosome *chromosome,
-                                   int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+                                   int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                   int stepBudget) {
     if (chromosome == nullptr || numOfUnits < 1 || pathsBetweenStations.empty()) {
         PrintError("Error: SwapStationFromRandomUnitPath received invalid parameters\n");
     }
@@ -697,22 +1105,22 @@ bool SwapStationFromRandomUnitPath(Chromosome *chromosome,
     }
 
     // Select a random eligible unit
-    int randUnitIndex = eligibleUnits[rand() % eligibleUnits.size()];
+    int randUnitIndex = eligibleUnits[RandomInt() % eligibleUnits.size()];
     vector<LocationID> &selectedPath = chromosome->unitPaths[randUnitIndex];
 
     int numberOfStops = selectedPath.size();
 
     // Generate 2 random stations.
-    randomIndex1 = rand() % (numberOfStops - 1) + 1;
+    randomIndex1 = RandomInt() % (numberOfStops - 1) + 1;
     do {
-        randomIndex2 = rand() % (numberOfStops - 1) + 1;
+        randomIndex2 = RandomInt() % (numberOfStops - 1) + 1;
     } while (randomIndex1 == randomIndex2);
 
     // Swap the order of arrival.
     swap(selectedPath[randomIndex1], selectedPath[randomIndex2]);
 
     // Check if the plan is executable under the step restriction.
-    if (IsValidPath(selectedPath, pathsBetweenStations)) {
+    if (IsValidPath(selectedPath, pathsBetweenStations, stepBudget)) {
         // Return that the chromosome was mutated
         return true;
     }
@@ -725,7 +1133,8 @@ bool SwapStationFromRandomUnitPath(Chromosome *chromosome,
 }
 
 bool SwapStationBetweenRandomUnitsPath(Chromosome *chromosome,
-                                       int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+                                       int numOfUnits, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                       int stepBudget) {
     if (chromosome == nullptr || numOfUnits < 1 || pathsBetweenStations.empty()) {
         PrintError("Error: SwapStationBetweenRandomUnitsPath received invalid parameters\n");
     }
@@ -749,10 +1158,10 @@ bool SwapStationBetweenRandomUnitsPath(Chromosome *chromosome,
     }
 
     // Select two different units randomly
-    int randIndex1 = rand() % eligibleUnits.size();
+    int randIndex1 = RandomInt() % eligibleUnits.size();
     int randIndex2;
     do {
-        randIndex2 = rand() % eligibleUnits.size();
+        randIndex2 = RandomInt() % eligibleUnits.size();
     } while (randIndex1 == randIndex2);
 
     int randUnitIndex1 = eligibleUnits[randIndex1];
@@ -767,13 +1176,14 @@ bool SwapStationBetweenRandomUnitsPath(Chromosome *chromosome,
     int numberOfStops2 = testPath2.size();
 
     // Get random station positions (skip the first position which is the start)
-    int randomIndex1 = rand() % (numberOfStops1 - 1) + 1;
-    int randomIndex2 = rand() % (numberOfStops2 - 1) + 1;
+    int randomIndex1 = RandomInt() % (numberOfStops1 - 1) + 1;
+    int randomIndex2 = RandomInt() % (numberOfStops2 - 1) + 1;
 
     // Swap and check if in step budget range.
     swap(testPath1[randomIndex1], testPath2[randomIndex2]);
 
-    if (IsValidPath(testPath1, pathsBetweenStations) && IsValidPath(testPath2, pathsBetweenStations)) {
+    if (IsValidPath(testPath1, pathsBetweenStations, stepBudget) &&
+        IsValidPath(testPath2, pathsBetweenStations, stepBudget)) {
         // If in budget, make the change on the real thing
         vector<LocationID> &selectedPath1 = chromosome->unitPaths[randUnitIndex1];
         vector<LocationID> &selectedPath2 = chromosome->unitPaths[randUnitIndex2];
@@ -787,51 +1197,505 @@ bool SwapStationBetweenRandomUnitsPath(Chromosome *chromosome,
     return false;
 }
 
+bool AddNeighbourStation(Chromosome *chromosome, int numOfUnits, const DistanceMatrix &distances,
+                         const NeighbourLists &neighbours, int stepBudget) {
+    if (chromosome == nullptr || numOfUnits < 1 || distances.size == 0 || neighbours.empty()) {
+        PrintError("Error: AddNeighbourStation received invalid parameters\n");
+        return false;
+    }
+    if (chromosome->unitPaths.size() < numOfUnits) {
+        PrintError("Error: AddNeighbourStation received numOfUnits to large\n");
+        return false;
+    }
+
+    // Chose a random unit and a random stop on its path, the entrance too so empty units can get a station
+    int randUnitIndex = RandomInt() % numOfUnits;
+    vector<LocationID> &selectedPath = chromosome->unitPaths[randUnitIndex];
+    int anchorIndex = RandomInt() % selectedPath.size();
+    const vector<LocationID> &candidates = neighbours[selectedPath[anchorIndex] + 1];
+    int pathSteps = PathDistance(selectedPath, distances);
+    if (candidates.empty() || pathSteps == -1) {
+        return false;
+    }
+
+    // Start from a random neighbour so the nearest one doesn't always win
+    int firstCandidate = RandomInt() % candidates.size();
+    for (int k = 0; k < candidates.size(); ++k) {
+        LocationID station = candidates[(firstCandidate + k) % candidates.size()];
+        if (chromosome->usedStations.test(station)) {
+            continue;
+        }
+
+        // Visit it right after its neighbour if the budget allows
+        int addedSteps = InsertionCost(selectedPath, anchorIndex + 1, station, distances);
+        if (pathSteps + addedSteps <= stepBudget) {
+            selectedPath.insert(selectedPath.begin() + anchorIndex + 1, station);
+            chromosome->usedStations.set(station);
+            chromosome->unitSteps[randUnitIndex] = pathSteps + addedSteps;
+            // Return that the chromosome was mutated
+            return true;
+        }
+    }
+
+    // Return that the chromosome wasn't mutated, all the neighbours are used or out of budget
+    return false;
+}
+
+bool SwapNeighbourStation(Chromosome *chromosome, int numOfUnits, const DistanceMatrix &distances,
+                          const NeighbourLists &neighbours, int stepBudget) {
+    if (chromosome == nullptr || numOfUnits < 1 || distances.size == 0 || neighbours.empty()) {
+        PrintError("Error: SwapNeighbourStation received invalid parameters\n");
+        return false;
+    }
+    if (chromosome->unitPaths.size() < numOfUnits) {
+        PrintError("Error: SwapNeighbourStation received numOfUnits to large\n");
+        return false;
+    }
+
+    // Chose a random unit, it needs at least one station to replace
+    int randUnitIndex = RandomInt() % numOfUnits;
+    vector<LocationID> &selectedPath = chromosome->unitPaths[randUnitIndex];
+    int numberOfStops = selectedPath.size();
+    if (numberOfStops < 2) {
+        return false;
+    }
+
+    int stationIndex = RandomInt() % (numberOfStops - 1) + 1;
+    LocationID oldStation = selectedPath[stationIndex];
+    const vector<LocationID> &candidates = neighbours[oldStation + 1];
+    if (candidates.empty()) {
+        return false;
+    }
+
+    // Start from a random neighbour so the nearest one doesn't always win
+    int firstCandidate = RandomInt() % candidates.size();
+    for (int k = 0; k < candidates.size(); ++k) {
+        LocationID station = candidates[(firstCandidate + k) % candidates.size()];
+        if (chromosome->usedStations.test(station)) {
+            continue;
+        }
+
+        // Put the neighbour in the same place and check if in step budget range
+        selectedPath[stationIndex] = station;
+        int pathSteps = PathDistance(selectedPath, distances);
+        if (pathSteps != -1 && pathSteps <= stepBudget) {
+            chromosome->usedStations.reset(oldStation);
+            chromosome->usedStations.set(station);
+            chromosome->unitSteps[randUnitIndex] = pathSteps;
+            // Return that the chromosome was mutated
+            return true;
+        }
+    }
+
+    // If no neighbour fits in the budget revert change
+    selectedPath[stationIndex] = oldStation;
+    return false;
+}
+
 bool Mutate(Chromosome *chromosome, const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
-            const map<PathKey, vector<Point> > &pathsBetweenStations) {
+            const map<PathKey, vector<Point> > &pathsBetweenStations, const DistanceMatrix &distances,
+            const NeighbourLists &neighbours, int stepBudget, MutationOperator mutationOperator) {
     if (chromosome == nullptr || importantPoints.empty() || numOfUnits < 1 || pathsBetweenStations.empty()) {
         PrintError("Error: Mutate received invalid parameters\n");
         return false;
     }
 
-    switch (rand() % 4) {
+    switch (mutationOperator) {
         // Choose mutation type
-        case 0:
+        case ADD_STATION:
             return AddStationToRandomUnitPath(chromosome, importantPoints, numOfUnits,
-                                              pathsBetweenStations);
-        case 1:
+                                              pathsBetweenStations, stepBudget);
+        case REMOVE_STATION:
             return RemoveStationFromRandomUnitPath(chromosome, numOfUnits);
-        case 2:
-            return SwapStationFromRandomUnitPath(chromosome, numOfUnits, pathsBetweenStations);
-        case 3:
-            return SwapStationBetweenRandomUnitsPath(chromosome, numOfUnits, pathsBetweenStations);
+        case SWAP_IN_UNIT:
+            return SwapStationFromRandomUnitPath(chromosome, numOfUnits, pathsBetweenStations, stepBudget);
+        case SWAP_BETWEEN_UNITS:
+            return SwapStationBetweenRandomUnitsPath(chromosome, numOfUnits, pathsBetweenStations, stepBudget);
+        case ADD_NEIGHBOUR_STATION:
+            return AddNeighbourStation(chromosome, numOfUnits, distances, neighbours, stepBudget);
+        case SWAP_NEIGHBOUR_STATION:
+            return SwapNeighbourStation(chromosome, numOfUnits, distances, neighbours, stepBudget);
         default:
             return false;
     }
 }
 
-void Mutation(Chromosome **nextGeneration, const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
-              const map<PathKey, vector<Point> > &pathsBetweenStations) {
+// Recalculate the probabilities from the operator qualities, an operator that is off gets no chance.
+// The minimal probability keeps the swap operators alive, they never raise the PValue themselves
+// but free the budget the add operator needs.
+void SetOperatorProbabilities(OperatorSelector &selector) {
+    double minProbability = MIN_OPERATOR_PROBABILITY / 100.0;
+    double qualitySum = 0;
+    int numOfEnabled = 0;
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        if (selector.enabled[o]) {
+            qualitySum += selector.quality[o];
+            ++numOfEnabled;
+        }
+    }
+
+    double numOfOperators = static_cast<double>(numOfEnabled);
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        if (!selector.enabled[o]) {
+            selector.probability[o] = 0;
+            continue;
+        }
+        double share = qualitySum > 0 ? selector.quality[o] / qualitySum : 1.0 / numOfOperators;
+        selector.probability[o] = minProbability + (1 - numOfOperators * minProbability) * share;
+    }
+}
+
+// Start every operator that is on with the same chance
+void InitOperatorSelector(OperatorSelector &selector, bool neighbourMutation) {
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        selector.enabled[o] = neighbourMutation || (o != ADD_NEIGHBOUR_STATION && o != SWAP_NEIGHBOUR_STATION);
+        selector.quality[o] = 0;
+        selector.generationGain[o] = 0;
+        selector.generationSeconds[o] = 0;
+    }
+    SetOperatorProbabilities(selector);
+}
+
+// Roulette wheel over the operator probabilities
+MutationOperator SelectMutationOperator(const OperatorSelector &selector) {
+    if (!ADAPTIVE_MUTATION) {
+        int numOfEnabled = 0;
+        for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+            numOfEnabled += selector.enabled[o] ? 1 : 0;
+        }
+        int pick = RandomInt() % numOfEnabled;
+        for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+            if (selector.enabled[o] && pick-- == 0) {
+                return static_cast<MutationOperator>(o);
+            }
+        }
+    }
+
+    double pick = RandomInt() / 2147483648.0;
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS - 1; ++o) {
+        pick -= selector.probability[o];
+        if (pick < 0) {
+            return static_cast<MutationOperator>(o);
+        }
+    }
+
+    // Rounding left a bit of the wheel, it goes to the last operator that is on
+    int last = NUM_OF_MUTATION_OPERATORS - 1;
+    while (last > 0 && !selector.enabled[last]) {
+        --last;
+    }
+    return static_cast<MutationOperator>(last);
+}
+
+// Move the operator qualities towards what they earned this generation and recalculate the probabilities
+void UpdateOperatorSelector(OperatorSelector &selector, GACounters &counters, bool publishProbabilities) {
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        if (selector.generationSeconds[o] > 0) {
+            double reward = selector.generationGain[o] / selector.generationSeconds[o];
+            selector.quality[o] += OPERATOR_ADAPTATION_RATE * (reward - selector.quality[o]);
+        }
+        selector.generationGain[o] = 0;
+        selector.generationSeconds[o] = 0;
+    }
+
+    SetOperatorProbabilities(selector);
+    if (publishProbabilities) {
+        for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+            counters.operatorProbability[o].store(selector.probability[o], std::memory_order_relaxed);
+        }
+    }
+}
+
+// Total PValue of the stations the chromosome visits
+double UsedStationsPValue(const Chromosome *chromosome, HostageStation **hostageStations) {
+    double sum = 0;
+    for (int s = 0; s < MAX_STATIONS; ++s) {
+        if (chromosome->usedStations.test(s)) {
+            sum += hostageStations[s]->GetPValue();
+        }
+    }
+    return sum;
+}
+
+void Mutation(Chromosome **nextGeneration, int populationSize,
+              const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+              const map<PathKey, vector<Point> > &pathsBetweenStations, const DistanceMatrix &distances,
+              const NeighbourLists &neighbours, int stepBudget, HostageStation **hostageStations,
+              OperatorSelector &selector, GACounters &counters) {
     if (nextGeneration == nullptr || importantPoints.empty() || numOfUnits < 1 || pathsBetweenStations.empty()) {
         PrintError("Error: Mutation received invalid parameters\n");
         return;
     }
 
-    for (int i = 0; i < POPULATION_SIZE; ++i) {
-        if (rand() % 100 < MUTATION_RATE) {
+    for (int i = 0; i < populationSize; ++i) {
+        if (RandomInt() % 100 < MUTATION_RATE) {
             if (nextGeneration[i] == nullptr) {
                 PrintWarning("Warning: Mutation received a null chromosome in nextGeneration at index: %d\n", i);
             } else {
+                MutationOperator mutationOperator = SelectMutationOperator(selector);
+                double fitnessBefore = UsedStationsPValue(nextGeneration[i], hostageStations);
+
                 // Mutate, and if any mutation type reported a change mark in chromosome
-                if (Mutate(nextGeneration[i], importantPoints, numOfUnits,
-                           pathsBetweenStations)) {
+                auto start = std::chrono::steady_clock::now();
+                bool changed = Mutate(nextGeneration[i], importantPoints, numOfUnits, pathsBetweenStations,
+                                      distances, neighbours, stepBudget, mutationOperator);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                // Failed attempts still cost time, so they lower the operator quality
+                selector.generationSeconds[mutationOperator] += seconds;
+                AtomicAdd(counters.operatorSeconds[mutationOperator], seconds);
+                counters.operatorApplications[mutationOperator].fetch_add(1, std::memory_order_relaxed);
+
+                if (changed) {
                     nextGeneration[i]->needsFitnessEvaluation = true; // Mark for re-evaluation
+                    nextGeneration[i]->lastMutation = mutationOperator;
+                    nextGeneration[i]->fitnessBeforeMutation = fitnessBefore;
+                    counters.operatorChanges[mutationOperator].fetch_add(1, std::memory_order_relaxed);
                 }
             }
         }
     }
 }
 
+// Give each mutation operator the fitness its offspring gained, call once the offspring are evaluated
+void CreditMutations(Chromosome **offspringPopulation, int populationSize, OperatorSelector &selector,
+                     GACounters &counters, bool publishProbabilities) {
+    for (int i = 0; i < populationSize; ++i) {
+        Chromosome *chromosome = offspringPopulation[i];
+        if (chromosome == nullptr || chromosome->lastMutation == -1) {
+            continue;
+        }
+
+        int mutationOperator = chromosome->lastMutation;
+        chromosome->lastMutation = -1;
+        double gain = chromosome->isValid ? chromosome->fitness - chromosome->fitnessBeforeMutation : 0;
+        if (chromosome->isValid && gain > -PVALUE_EPSILON) {
+            // The move kept the plan valid and didn't cost any PValue
+            counters.operatorAccepted[mutationOperator].fetch_add(1, std::memory_order_relaxed);
+        }
+        if (gain > PVALUE_EPSILON) {
+            selector.generationGain[mutationOperator] += gain;
+            counters.operatorImprovements[mutationOperator].fetch_add(1, std::memory_order_relaxed);
+            AtomicAdd(counters.operatorGain[mutationOperator], gain);
+        }
+    }
+
+    UpdateOperatorSelector(selector, counters, publishProbabilities);
+}
+
+// Shorten the route of each unit with 2-opt and Or-opt, return if any route was changed
+bool ImproveUnitsOrder(Chromosome *chromosome, const DistanceMatrix &distances) {
+    bool improved = false;
+
+    for (int u = 0; u < chromosome->unitPaths.size(); ++u) {
+        vector<LocationID> &unitPath = chromosome->unitPaths[u];
+        if (TryTwoOpt(unitPath, distances) || TryOrOpt(unitPath, distances)) {
+            chromosome->unitSteps[u] = PathDistance(unitPath, distances);
+            improved = true;
+        }
+    }
+
+    return improved;
+}
+
+// Move one station to the cheapest place in another unit if it saves steps, return if the chromosome was changed
+bool RelocateStationBetweenUnits(Chromosome *chromosome, const DistanceMatrix &distances, int stepBudget,
+                                 std::mt19937 &rng) {
+    int numOfUnits = chromosome->unitPaths.size();
+    if (numOfUnits < 2) {
+        return false;
+    }
+
+    // Start from a random unit so the same unit doesn't always get the first chance
+    int firstUnit = rng() % numOfUnits;
+    for (int a = 0; a < numOfUnits; ++a) {
+        int fromUnit = (firstUnit + a) % numOfUnits;
+        vector<LocationID> &fromPath = chromosome->unitPaths[fromUnit];
+
+        for (int i = 1; i < fromPath.size(); ++i) {
+            int gain = RemovalGain(fromPath, i, distances);
+
+            for (int toUnit = 0; toUnit < numOfUnits; ++toUnit) {
+                if (toUnit == fromUnit) {
+                    continue;
+                }
+                vector<LocationID> &toPath = chromosome->unitPaths[toUnit];
+
+                for (int position = 1; position <= toPath.size(); ++position) {
+                    int cost = InsertionCost(toPath, position, fromPath[i], distances);
+                    if (cost < gain && chromosome->unitSteps[toUnit] + cost <= stepBudget) {
+                        // Move the station and update both step counts
+                        toPath.insert(toPath.begin() + position, fromPath[i]);
+                        fromPath.erase(fromPath.begin() + i);
+                        chromosome->unitSteps[toUnit] += cost;
+                        chromosome->unitSteps[fromUnit] -= gain;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// Exchange two stations of different units if both stay in budget and fewer steps are taken in total,
+// return if the chromosome was changed
+bool ExchangeStationBetweenUnits(Chromosome *chromosome, const DistanceMatrix &distances, int stepBudget,
+                                 std::mt19937 &rng) {
+    int numOfUnits = chromosome->unitPaths.size();
+    if (numOfUnits < 2) {
+        return false;
+    }
+
+    int firstUnit = rng() % numOfUnits;
+    for (int a = 0; a < numOfUnits; ++a) {
+        int unit1 = (firstUnit + a) % numOfUnits;
+        for (int unit2 = unit1 + 1; unit2 < numOfUnits; ++unit2) {
+            vector<LocationID> &path1 = chromosome->unitPaths[unit1];
+            vector<LocationID> &path2 = chromosome->unitPaths[unit2];
+
+            for (int i = 1; i < path1.size(); ++i) {
+                for (int j = 1; j < path2.size(); ++j) {
+                    swap(path1[i], path2[j]);
+                    int steps1 = PathDistance(path1, distances);
+                    int steps2 = PathDistance(path2, distances);
+
+                    if (steps1 != -1 && steps2 != -1 && steps1 <= stepBudget && steps2 <= stepBudget &&
+                        steps1 + steps2 < chromosome->unitSteps[unit1] + chromosome->unitSteps[unit2]) {
+                        chromosome->unitSteps[unit1] = steps1;
+                        chromosome->unitSteps[unit2] = steps2;
+                        return true;
+                    }
+
+                    // Not better, revert the exchange
+                    swap(path1[i], path2[j]);
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// Insert the unused station with the best PValue per added step where the budget allows,
+// return if a station was added
+bool InsertBestUnusedStation(Chromosome *chromosome, const vector<pair<LocationID, Point> > &importantPoints,
+                             const DistanceMatrix &distances, int stepBudget, HostageStation **hostageStations) {
+    LocationID bestStation = -1;
+    int bestUnit = -1;
+    int bestPosition = -1;
+    int bestCost = 0;
+    double bestScore = -1;
+
+    for (int i = 1; i < importantPoints.size(); ++i) {
+        LocationID station = importantPoints[i].first;
+        if (chromosome->usedStations.test(station)) {
+            continue;
+        }
+        double pValue = hostageStations[station]->GetPValue();
+
+        for (int u = 0; u < chromosome->unitPaths.size(); ++u) {
+            const vector<LocationID> &unitPath = chromosome->unitPaths[u];
+            for (int position = 1; position <= unitPath.size(); ++position) {
+                int cost = InsertionCost(unitPath, position, station, distances);
+                if (chromosome->unitSteps[u] + cost > stepBudget) {
+                    continue;
+                }
+
+                double score = pValue / (cost + 1);
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestStation = station;
+                    bestUnit = u;
+                    bestPosition = position;
+                    bestCost = cost;
+                }
+            }
+        }
+    }
+
+    if (bestStation == -1) {
+        // No unused station fits in any unit budget
+        return false;
+    }
+
+    vector<LocationID> &unitPath = chromosome->unitPaths[bestUnit];
+    unitPath.insert(unitPath.begin() + bestPosition, bestStation);
+    chromosome->unitSteps[bestUnit] += bestCost;
+    chromosome->usedStations.set(bestStation);
+    return true;
+}
+
+// Bounded local search: shorten routes, rebalance stations between units and use the freed budget for new stations
+void LocalSearchChromosome(Chromosome *chromosome, const vector<pair<LocationID, Point> > &importantPoints,
+                           const DistanceMatrix &distances, int stepBudget, HostageStation **hostageStations,
+                           std::mt19937 &rng) {
+    if (chromosome == nullptr || hostageStations == nullptr) {
+        PrintError("Error: LocalSearchChromosome received null parameters\n");
+        return;
+    }
+
+    UpdateUnitSteps(chromosome, distances);
+    RebuildStationUsage(chromosome);
+
+    for (int iteration = 0; iteration < MEMETIC_MAX_ITERATIONS; ++iteration) {
+        // Each iteration makes at most one move, the cheapest kinds are tried first
+        bool improved = InsertBestUnusedStation(chromosome, importantPoints, distances, stepBudget, hostageStations) ||
+                        ImproveUnitsOrder(chromosome, distances) ||
+                        RelocateStationBetweenUnits(chromosome, distances, stepBudget, rng) ||
+                        ExchangeStationBetweenUnits(chromosome, distances, stepBudget, rng);
+        if (!improved) {
+            // Local optimum reached
+            break;
+        }
+    }
+}
+
+// Run the local search on one offspring and evaluate it
+void ImproveOffspring(Chromosome *chromosome, const vector<pair<LocationID, Point> > &importantPoints,
+                      const map<PathKey, vector<Point> > &pathsBetweenStations, const DistanceMatrix &distances,
+                      int stepBudget, HostageStation **hostageStations, unsigned int seed, GACounters &counters) {
+    // Only improve plans that can be carried out, the rest will get the penalty fitness
+    if (!IsValidChromosome(chromosome, pathsBetweenStations, stepBudget)) {
+        return;
+    }
+
+    std::mt19937 rng(seed);
+    LocalSearchChromosome(chromosome, importantPoints, distances, stepBudget, hostageStations, rng);
+
+    // The gain now comes from the local search too, so the mutation operator doesn't get the credit
+    chromosome->lastMutation = -1;
+
+    // Evaluate here, while the chromosome is still hot in this thread cache
+    CalculateFitness(chromosome, pathsBetweenStations, stepBudget, hostageStations, counters);
+}
+
+void MemeticStep(Chromosome **offspringPopulation, int populationSize,
+                 const vector<pair<LocationID, Point> > &importantPoints,
+                 const map<PathKey, vector<Point> > &pathsBetweenStations, const DistanceMatrix &distances,
+                 int stepBudget, HostageStation **hostageStations, ParallelRegion &region, GACounters &counters) {
+    if (offspringPopulation == nullptr || hostageStations == nullptr) {
+        PrintError("Error: MemeticStep received null parameters\n");
+        return;
+    }
+
+    // Pick the offspring first, the random engine belongs to this thread so each search gets its own seed
+    vector<pair<int, unsigned int> > picked;
+    for (int i = 0; i < populationSize; ++i) {
+        if (offspringPopulation[i] == nullptr || RandomInt() % 100 >= MEMETIC_RATE) {
+            continue;
+        }
+        picked.emplace_back(i, RandomInt());
+    }
+
+    // One local search per chunk, they take much longer than a fitness evaluation
+    region.ParallelFor(0, static_cast<int>(picked.size()), 1, [&](int p) {
+        ImproveOffspring(offspringPopulation[picked[p].first], importantPoints, pathsBetweenStations, distances,
+                         stepBudget, hostageStations, picked[p].second, counters);
+    });
+}
+
 bool compareChromosomePtrsByFitnessDesc (Chromosome* a, Chromosome* b) {
     if (a == nullptr && b == nullptr) return false; // Equal if both null
     if (a == nullptr) return false; // b must be not null
@@ -840,26 +1704,27 @@ bool compareChromosomePtrsByFitnessDesc (Chromosome* a, Chromosome* b) {
     return a->fitness > b->fitness; // For descending order (highest fitness first)
 };
 
-void PerformElitismAndReplacement(Chromosome **currentPopulation, Chromosome **offspringPopulation) {
+void PerformElitismAndReplacement(Chromosome **currentPopulation, Chromosome **offspringPopulation,
+                                  int populationSize) {
     if (currentPopulation == nullptr || offspringPopulation == nullptr) {
         PrintError("Error: PerformElitismAndReplacement received invalid parameters\n");
         return;
     }
 
     // Partition current population: fittest elites at the start.
-    std::nth_element(currentPopulation, currentPopulation + NUM_OF_ELITS, currentPopulation + POPULATION_SIZE,
+    std::nth_element(currentPopulation, currentPopulation + NUM_OF_ELITS, currentPopulation + populationSize,
                      compareChromosomePtrsByFitnessDesc);
 
     // Number of offspring needed to fill the rest of the next generation.
-    int numOffspringToKeep = POPULATION_SIZE - NUM_OF_ELITS;
+    int numOffspringToKeep = populationSize - NUM_OF_ELITS;
 
     // Partition offspring population: fittest to replace non-elites at the start.
-    std::nth_element(offspringPopulation, offspringPopulation + numOffspringToKeep, offspringPopulation + POPULATION_SIZE,
+    std::nth_element(offspringPopulation, offspringPopulation + numOffspringToKeep, offspringPopulation + populationSize,
                      compareChromosomePtrsByFitnessDesc);
 
 
     // Replace the non-elite chromosomes in currentPopulation with the selected offspring.
-    for (int i = NUM_OF_ELITS; i < POPULATION_SIZE; ++i) {
+    for (int i = NUM_OF_ELITS; i < populationSize; ++i) {
         if (offspringPopulation[i] != nullptr) {
             delete currentPopulation[i]; // Delete the old, less fit chromosome.
         }
@@ -868,7 +1733,7 @@ void PerformElitismAndReplacement(Chromosome **currentPopulation, Chromosome **o
     }
 
     // Delete the offspring chromosomes that were not selected for the next generation.
-    for (int i = numOffspringToKeep; i < POPULATION_SIZE; ++i) {
+    for (int i = numOffspringToKeep; i < populationSize; ++i) {
         // Safety check
         if (offspringPopulation[i] != nullptr) {
             delete offspringPopulation[i];
@@ -877,75 +1742,274 @@ void PerformElitismAndReplacement(Chromosome **currentPopulation, Chromosome **o
     }
 }
 
-void OrderPathBruteForce(vector<LocationID> &path, const map<PathKey, vector<Point> > &pathsBetweenStations) {
-    if (path.empty()) {
-        PrintWarning("Warning: OrderPathBruteForce received an empty path\n");
-        return;
-    }
-    // If there are no other locations to visit, the path is just the entrance.
-    if (path.size() == 1) {
-        return;
-    }
-    if (pathsBetweenStations.empty()) {
-        PrintError("Error: OrderPathBruteForce received an empty pathsBetweenStations");
+// Bound the PValue with a fractional knapsack: every station in a plan is entered by exactly one segment,
+// which costs at least the cheapest path into the station, and all units together have
+// numOfUnits * stepBudget steps to spend on those segments.
+double PValueUpperBound(const DistanceMatrix &distances, const vector<pair<LocationID, Point> > &importantPoints,
+                        int numOfUnits, HostageStation **hostageStations, int stepBudget) {
+    // pair of (PValue per step, station index in importantPoints)
+    vector<pair<double, int> > stationsByRatio;
+    vector<int> entryCosts(importantPoints.size(), 0);
+    double freeValue = 0;
+
+    for (int i = 1; i < importantPoints.size(); ++i) {
+        LocationID station = importantPoints[i].first;
+        int fromEntrance = distances.GetCost(importantPoints[0].first, station);
+        if (fromEntrance == -1 || fromEntrance > stepBudget) {
+            // No unit can get there
+            continue;
+        }
+
+        // The cheapest way into the station, from the entrance or from any other station
+        int entryCost = fromEntrance;
+        for (int j = 1; j < importantPoints.size(); ++j) {
+            int cost = distances.GetCost(importantPoints[j].first, station);
+            if (j != i && cost != -1 && cost < entryCost) {
+                entryCost = cost;
+            }
+        }
+
+        double pValue = hostageStations[station]->GetPValue();
+        if (entryCost == 0) {
+            // Costs nothing to take, always part of the bound
+            freeValue += pValue;
+            continue;
+        }
+        entryCosts[i] = entryCost;
+        stationsByRatio.emplace_back(pValue / entryCost, i);
     }
 
-    vector<LocationID> stations;
-    for (int i = 1; i < path.size(); ++i) {
-        stations.push_back(path.at(i));
+    // Greedy fractional knapsack, best PValue per step first
+    std::sort(stationsByRatio.begin(), stationsByRatio.end(), std::greater<pair<double, int> >());
+
+    double bound = freeValue;
+    double capacity = static_cast<double>(numOfUnits) * stepBudget;
+    for (const pair<double, int> &station: stationsByRatio) {
+        int entryCost = entryCosts[station.second];
+        if (entryCost <= capacity) {
+            bound += station.first * entryCost;
+            capacity -= entryCost;
+        } else {
+            // Take the fraction of the station that still fits
+            bound += station.first * capacity;
+            break;
+        }
     }
 
-    int minTotalDistance = PathDistance(path, pathsBetweenStations);
-    if (minTotalDistance == -1) {
-        PrintError("Error: OrderPathBruteForce origin path has distance -1");
-        return;
+    return bound;
+}
+
+double PValueUpperBound(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                        const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                        HostageStation **hostageStations, int stepBudget) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: PValueUpperBound received invalid input\n");
+        return 0.0;
     }
 
-    // Need to sure to use next_permutation()
-    sort(stations.begin(), stations.end());
+    DistanceMatrix distances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+    return PValueUpperBound(distances, importantPoints, numOfUnits, hostageStations, stepBudget);
+}
 
-    do {
-        vector<LocationID> currentPath;
-        currentPath.push_back(path.front()); // Always start at the units entrance
-        for (LocationID id: stations) {
-            currentPath.push_back(id); // Add current permutation
+// Add the counters of one population to the stats. Only one population publishes its operator probabilities,
+// they are taken from whichever did.
+void AddCounters(GAStats &stats, const GACounters &counters) {
+    stats.evaluations += counters.evaluations.load(std::memory_order_relaxed);
+    stats.invalidEvaluations += counters.invalidEvaluations.load(std::memory_order_relaxed);
+    stats.cacheLookups += counters.cacheLookups.load(std::memory_order_relaxed);
+    stats.cacheHits += counters.cacheHits.load(std::memory_order_relaxed);
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        MutationOperatorStats &operatorStats = stats.mutationOperators[o];
+        operatorStats.applications += counters.operatorApplications[o].load(std::memory_order_relaxed);
+        operatorStats.changes += counters.operatorChanges[o].load(std::memory_order_relaxed);
+        operatorStats.improvements += counters.operatorImprovements[o].load(std::memory_order_relaxed);
+        operatorStats.accepted += counters.operatorAccepted[o].load(std::memory_order_relaxed);
+        operatorStats.totalGain += counters.operatorGain[o].load(std::memory_order_relaxed);
+        operatorStats.seconds += counters.operatorSeconds[o].load(std::memory_order_relaxed);
+        double probability = counters.operatorProbability[o].load(std::memory_order_relaxed);
+        if (probability > 0) {
+            operatorStats.probability = probability;
         }
+    }
+}
+
+// Sum the counters of the run so far
+GAStats GetStats(const GARunState &state) {
+    GAStats stats;
+    AddCounters(stats, state.counters);
+    for (const std::unique_ptr<GACounters> &counters: state.islandCounters) {
+        AddCounters(stats, *counters);
+    }
+    stats.secondsToTarget = state.secondsToTarget.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Record the fittest chromosome of a generation, report progress and check every stop criterion.
+// Returns if the GA should stop.
+bool UpdateRunState(GARunState &state, int generation, const Chromosome *fittest, double &lastBestFitness,
+                    int &stagnantGenerations, bool reportProgress) {
+    const GAOptions &options = *state.options;
 
-        int currentTotalDistance = PathDistance(currentPath, pathsBetweenStations);
+    if (fittest != nullptr && fittest->isValid) {
+        state.bestSoFar->Offer(fittest->unitPaths, fittest->fitness);
+    }
 
-        // Update if found a better plan
-        if (currentTotalDistance < minTotalDistance) {
-            minTotalDistance = currentTotalDistance;
-            path = currentPath;
+    // Stagnation is measured against the best plan of the whole run, not only this population
+    double bestFitness = state.bestSoFar->GetFitness();
+    if (bestFitness > lastBestFitness) {
+        lastBestFitness = bestFitness;
+        stagnantGenerations = 0;
+    } else {
+        ++stagnantGenerations;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (options.targetFitness >= 0 && bestFitness >= options.targetFitness - PVALUE_EPSILON &&
+        state.secondsToTarget.load(std::memory_order_relaxed) < 0) {
+        // Only the first island that sees the target reached keeps its time
+        double notReached = -1;
+        state.secondsToTarget.compare_exchange_strong(notReached,
+                                                      std::chrono::duration<double>(now - state.start).count(),
+                                                      std::memory_order_relaxed);
+    }
+
+    bool shouldStop = state.stop.load(std::memory_order_relaxed) || now >= options.deadline ||
+                      options.cancel.IsCancelled() ||
+                      (options.maxStagnantGenerations > 0 && stagnantGenerations >= options.maxStagnantGenerations) ||
+                      (options.targetFitness >= 0 && bestFitness >= options.targetFitness - PVALUE_EPSILON) ||
+                      (options.stopAtUpperBound && bestFitness >= state.upperBound - PVALUE_EPSILON);
+
+    if (reportProgress && options.onProgress && options.progressInterval > 0 &&
+        generation % options.progressInterval == 0) {
+        GAProgress progress;
+        progress.generation = generation;
+        progress.bestFitness = bestFitness;
+        progress.generationsWithoutImprovement = stagnantGenerations;
+        progress.elapsedSeconds = std::chrono::duration<double>(now - state.start).count();
+        progress.upperBound = state.upperBound;
+        progress.stats = GetStats(state);
+        progress.bestPlan = state.bestSoFar->GetPlan();
+
+        // The caller can ask to stop
+        if (!options.onProgress(progress)) {
+            shouldStop = true;
         }
-    } while (next_permutation(stations.begin(), stations.end())); // Run until we have covered all possible permutations
+    }
+
+    if (shouldStop) {
+        // Let the other islands know
+        state.stop.store(true, std::memory_order_relaxed);
+    }
+    return shouldStop;
 }
 
+// Copy the state of the run for the checkpoint writer, the generation loop only waits for this copy
+std::unique_ptr<GACheckpoint> MakeCheckpoint(Chromosome **population, int populationSize, int numOfUnits,
+                                             int generation, const OperatorSelector &selector,
+                                             double lastBestFitness, int stagnantGenerations,
+                                             const GARunState &state) {
+    std::unique_ptr<GACheckpoint> checkpoint(new GACheckpoint());
+    checkpoint->scenarioHash = state.scenarioHash;
+    checkpoint->generation = generation;
+    checkpoint->numOfUnits = numOfUnits;
+    checkpoint->stepBudget = state.options->stepBudget;
+    checkpoint->stagnantGenerations = stagnantGenerations;
+    checkpoint->lastBestFitness = lastBestFitness;
+
+    checkpoint->population.reserve(populationSize);
+    checkpoint->fitness.reserve(populationSize);
+    checkpoint->isValid.reserve(populationSize);
+    for (int i = 0; i < populationSize; ++i) {
+        checkpoint->population.push_back(population[i]->unitPaths);
+        checkpoint->fitness.push_back(population[i]->fitness);
+        checkpoint->isValid.push_back(population[i]->isValid);
+    }
+
+    checkpoint->operatorQuality.assign(selector.quality, selector.quality + NUM_OF_MUTATION_OPERATORS);
+    checkpoint->operatorProbability.assign(selector.probability, selector.probability + NUM_OF_MUTATION_OPERATORS);
+
+    std::ostringstream randomState;
+    randomState << RandomEngine();
+    checkpoint->randomState = randomState.str();
+
+    checkpoint->bestPlan = state.bestSoFar->GetPlan();
+    checkpoint->bestFitness = state.bestSoFar->GetFitness();
+    return checkpoint;
+}
 
-// Order a path in the shortest way in number of steps using Brute Force for each of the untis
-void FindBestPathInPlanBruteForce(vector<vector<LocationID> > &fullPlan,
-                                  const map<PathKey, vector<Point> > &pathsBetweenStations) {
-    if (pathsBetweenStations.empty()) {
-        PrintError("Error: pathsBetweenStations received an empty pathsBetweenStations");
+// Check that the checkpoint was saved by a run of the same scenario and settings
+bool IsCheckpointCompatible(const GACheckpoint &checkpoint, uint64_t scenarioHash, int numOfUnits, int stepBudget) {
+    if (checkpoint.scenarioHash != scenarioHash || checkpoint.numOfUnits != numOfUnits ||
+        checkpoint.stepBudget != stepBudget ||
+        checkpoint.population.size() != POPULATION_SIZE ||
+        checkpoint.operatorQuality.size() != NUM_OF_MUTATION_OPERATORS ||
+        checkpoint.operatorProbability.size() != NUM_OF_MUTATION_OPERATORS) {
+        return false;
     }
-    for (vector<LocationID> &plan: fullPlan) {
-        OrderPathBruteForce(plan, pathsBetweenStations);
+
+    // Every saved path must start at the entrance and only visit stations of the scenario
+    for (const vector<vector<LocationID> > &chromosome: checkpoint.population) {
+        if (chromosome.size() != numOfUnits) {
+            return false;
+        }
+        for (const vector<LocationID> &unitPath: chromosome) {
+            if (unitPath.empty() || unitPath[0] != -1) {
+                return false;
+            }
+            for (int s = 1; s < unitPath.size(); ++s) {
+                if (unitPath[s] < 0 || unitPath[s] >= MAX_STATIONS) {
+                    return false;
+                }
+            }
+        }
     }
+    return true;
 }
 
-vector<vector<LocationID> > MainAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
-                                          const vector<pair<LocationID, Point> > &importantPoints,
-                                          int numOfUnits, HostageStation **hostageStations) {
-    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
-        PrintError("Error: MainAlgorithm received in valid input");
-        return vector<vector<LocationID> >();
+// Put the saved population, operator selection and random engine back, return the generation to continue from
+int RestoreCheckpoint(const GACheckpoint &checkpoint, Chromosome **population, int populationSize,
+                      const DistanceMatrix &distances, OperatorSelector &selector, double &lastBestFitness,
+                      int &stagnantGenerations) {
+    for (int i = 0; i < populationSize; ++i) {
+        Chromosome *chromosome = population[i];
+        chromosome->unitPaths = checkpoint.population[i];
+        chromosome->usedStations.reset();
+        for (const vector<LocationID> &unitPath: chromosome->unitPaths) {
+            for (int s = 1; s < unitPath.size(); ++s) {
+                chromosome->usedStations.set(unitPath[s]);
+            }
+        }
+        UpdateUnitSteps(chromosome, distances);
+
+        // The saved fitness is still right, no need to evaluate again
+        chromosome->fitness = checkpoint.fitness[i];
+        chromosome->isValid = checkpoint.isValid[i];
+        chromosome->needsFitnessEvaluation = false;
     }
 
-    // Create thread pool with hardware_concurrency threads
-    ThreadPool pool(thread::hardware_concurrency());
+    // The saved probabilities follow from the saved qualities. They are worked out again so a run resumed with
+    // options.neighbourMutation switched gives no chance to the operators that are off.
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        selector.quality[o] = selector.enabled[o] ? checkpoint.operatorQuality[o] : 0;
+    }
+    SetOperatorProbabilities(selector);
+
+    std::istringstream randomState(checkpoint.randomState);
+    randomState >> RandomEngine();
+
+    lastBestFitness = checkpoint.lastBestFitness;
+    stagnantGenerations = checkpoint.stagnantGenerations;
+    return checkpoint.generation;
+}
 
+// Run the GA on one population, using the thread pool to evaluate and improve the offspring
+vector<vector<LocationID> > RunSinglePopulation(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                                const vector<pair<LocationID, Point> > &importantPoints,
+                                                const DistanceMatrix &distances, int numOfUnits,
+                                                HostageStation **hostageStations, ThreadPool &pool,
+                                                GARunState &state) {
     // Allocate memory for population
-    Chromosome **currentPopulation = AllocateChromosomePopulation(numOfUnits);
+    Chromosome **currentPopulation = AllocateChromosomePopulation(numOfUnits, POPULATION_SIZE);
     Chromosome **matingPool = (Chromosome **) malloc(sizeof(Chromosome *) * POPULATION_SIZE);
     Chromosome **offspringPopulation = (Chromosome **) malloc(sizeof(Chromosome *) * POPULATION_SIZE);
     if (currentPopulation == nullptr || matingPool == nullptr || offspringPopulation == nullptr) {
@@ -953,43 +2017,406 @@ vector<vector<LocationID> > MainAlgorithm(const map<PathKey, vector<Point> > &pa
         return vector<vector<LocationID> >();
     }
 
-    // Create and evaluate Generation 0
-    bool GASucceed = Initialization(currentPopulation, pathsBetweenStations, importantPoints, numOfUnits);
-    if (!GASucceed) {
-        PrintError("Error: MainAlgorithm couldn't initialize chromosomes.");
-        return vector<vector<LocationID> >();
+    int stepBudget = state.options->stepBudget;
+    ParallelRegion region(pool, state.options->persistentRegion, state.options->priority);
+    OperatorSelector selector;
+    InitOperatorSelector(selector, state.options->neighbourMutation);
+    double lastBestFitness = -1;
+    int stagnantGenerations = 0;
+    int startGeneration = 0;
+
+    if (state.resumeFrom != nullptr) {
+        // Continue the saved run where it stopped
+        startGeneration = RestoreCheckpoint(*state.resumeFrom, currentPopulation, POPULATION_SIZE, distances,
+                                            selector, lastBestFitness, stagnantGenerations);
+    } else {
+        // Create and evaluate Generation 0
+        bool GASucceed = Initialization(currentPopulation, POPULATION_SIZE, pathsBetweenStations, importantPoints,
+                                        numOfUnits, stepBudget);
+        if (!GASucceed) {
+            PrintError("Error: MainAlgorithm couldn't initialize chromosomes.");
+            return vector<vector<LocationID> >();
+        }
+        SeedConstructedPlans(currentPopulation, POPULATION_SIZE, distances, importantPoints, numOfUnits,
+                             hostageStations, stepBudget);
+        if (state.warmStartPlan != nullptr) {
+            SeedFromPreviousPlan(currentPopulation, POPULATION_SIZE, *state.warmStartPlan, distances,
+                                 importantPoints, hostageStations, stepBudget);
+        }
+
+        EvaluatePopulationFitness(currentPopulation, POPULATION_SIZE, pathsBetweenStations, distances, stepBudget,
+                                  hostageStations, region, state.fitnessCache, state.counters);
     }
 
-    EvaluatePopulationFitness(currentPopulation, pathsBetweenStations, hostageStations, pool);
+    bool stop = UpdateRunState(state, startGeneration, GetFittestChromosome(currentPopulation, POPULATION_SIZE, pool),
+                               lastBestFitness, stagnantGenerations, true);
 
-    for (int G = 0; G < GENERATIONS; ++G) {
+    // Checkpoints are written from their own thread, the loop only copies the state
+    std::unique_ptr<CheckpointWriter> checkpointWriter;
+    if (!state.options->checkpointPath.empty()) {
+        checkpointWriter.reset(new CheckpointWriter(state.options->checkpointPath));
+    }
+    int checkpointInterval = std::max(1, state.options->checkpointInterval);
+
+    int G = startGeneration;
+    for (; G < state.options->maxGenerations && !stop; ++G) {
         // 1. Selection: Choose parents from currentPopulation based on fitness, fill matingPool
-        Selection(currentPopulation, matingPool);
+        Selection(currentPopulation, matingPool, POPULATION_SIZE);
 
         // 2. Crossover: Create new offspring from matingPool.
-        Crossover(matingPool, offspringPopulation, numOfUnits);
+        Crossover(matingPool, offspringPopulation, POPULATION_SIZE, numOfUnits, distances, stepBudget);
 
         // // 3. Mutation: Apply mutations to some of the newly created offspring (in offspringPopulation)
-        Mutation(offspringPopulation, importantPoints, numOfUnits, pathsBetweenStations);
+        Mutation(offspringPopulation, POPULATION_SIZE, importantPoints, numOfUnits, pathsBetweenStations, distances,
+                 state.neighbours, stepBudget, hostageStations, selector, state.counters);
+
+        // 3.5. Memetic step: Local search on some of the offspring (evaluates the ones it improves)
+        if (MEMETIC_RATE > 0) {
+            MemeticStep(offspringPopulation, POPULATION_SIZE, importantPoints, pathsBetweenStations, distances,
+                        stepBudget, hostageStations, region, state.counters);
+        }
 
         // 4. Evaluate Fitness of New Offspring using the thread pool
         // Only evaluates offspring marked as needing evaluation by Crossover/Mutation.
-        EvaluatePopulationFitness(offspringPopulation, pathsBetweenStations, hostageStations, pool);
+        EvaluatePopulationFitness(offspringPopulation, POPULATION_SIZE, pathsBetweenStations, distances,
+                                  stepBudget, hostageStations, region, state.fitnessCache, state.counters);
+
+        // 4.5. Reward the mutation operators by how much they improved their offspring
+        CreditMutations(offspringPopulation, POPULATION_SIZE, selector, state.counters, true);
 
         // 5. Creat the real next generation
-        PerformElitismAndReplacement(currentPopulation, offspringPopulation);
+        PerformElitismAndReplacement(currentPopulation, offspringPopulation, POPULATION_SIZE);
+
+        // 6. Check the deadline and the convergence criteria
+        stop = UpdateRunState(state, G + 1, GetFittestChromosome(currentPopulation, POPULATION_SIZE, pool),
+                              lastBestFitness, stagnantGenerations, true);
+
+        // 7. Hand a copy of the state to the checkpoint writer
+        if (checkpointWriter != nullptr && (G + 1) % checkpointInterval == 0) {
+            checkpointWriter->Submit(MakeCheckpoint(currentPopulation, POPULATION_SIZE, numOfUnits, G + 1, selector,
+                                                    lastBestFitness, stagnantGenerations, state));
+        }
+    }
+
+    // Save where the run ended too, so a run stopped by its deadline can go on later
+    if (checkpointWriter != nullptr && G % checkpointInterval != 0) {
+        checkpointWriter->Submit(MakeCheckpoint(currentPopulation, POPULATION_SIZE, numOfUnits, G, selector,
+                                                lastBestFitness, stagnantGenerations, state));
+    }
+
+    vector<vector<LocationID> > bestPlan = GetFittestChromosome(currentPopulation, POPULATION_SIZE, pool)->unitPaths;
+
+    // Deallocate population
+    DeallocateChromosomePopulation(currentPopulation, POPULATION_SIZE);
+    free(matingPool);
+    free(offspringPopulation);
+
+    return bestPlan;
+}
+
+// Send copies of the fittest chromosomes of the island to its neighbour
+void SendMigrants(Island &island, Chromosome **population) {
+    std::nth_element(population, population + NUM_OF_MIGRANTS, population + island.populationSize,
+                     compareChromosomePtrsByFitnessDesc);
+
+    for (int i = 0; i < NUM_OF_MIGRANTS; ++i) {
+        Chromosome *migrant = new Chromosome(*population[i]);
+        if (!island.outbox->Push(migrant)) {
+            // The neighbour hasn't taken the last migrants yet, drop this one
+            delete migrant;
+        }
+    }
+}
+
+// Replace the least fit chromosomes of the island with the migrants waiting in its mailbox
+void ReceiveMigrants(Island &island, Chromosome **population) {
+    vector<Chromosome *> migrants;
+    while (Chromosome *migrant = island.inbox->Pop()) {
+        migrants.push_back(migrant);
+    }
+    if (migrants.empty()) {
+        return;
+    }
+
+    // Keep only as many migrants as there are non-elite places
+    while (migrants.size() > island.populationSize - NUM_OF_ELITS) {
+        delete migrants.back();
+        migrants.pop_back();
+    }
+
+    // Move the least fit chromosomes to the end of the population and replace them
+    int numToKeep = island.populationSize - migrants.size();
+    std::nth_element(population, population + numToKeep, population + island.populationSize,
+                     compareChromosomePtrsByFitnessDesc);
+    for (int i = 0; i < migrants.size(); ++i) {
+        delete population[numToKeep + i];
+        population[numToKeep + i] = migrants[i];
+    }
+}
+
+// Run a full GA on the island population, only talking to the other islands through the mailboxes
+void RunIsland(Island &island, const map<PathKey, vector<Point> > &pathsBetweenStations,
+               const vector<pair<LocationID, Point> > &importantPoints, const DistanceMatrix &distances,
+               int numOfUnits, HostageStation **hostageStations) {
+    int populationSize = island.populationSize;
+
+    // Allocate memory for population
+    Chromosome **currentPopulation = AllocateChromosomePopulation(numOfUnits, populationSize);
+    Chromosome **matingPool = (Chromosome **) malloc(sizeof(Chromosome *) * populationSize);
+    Chromosome **offspringPopulation = (Chromosome **) malloc(sizeof(Chromosome *) * populationSize);
+    if (currentPopulation == nullptr || matingPool == nullptr || offspringPopulation == nullptr) {
+        PrintError("Error: RunIsland couldn't allocate array of pointers to chromosomes.");
+        return;
+    }
+
+    // Create and evaluate Generation 0
+    int stepBudget = island.runState->options->stepBudget;
+    if (!Initialization(currentPopulation, populationSize, pathsBetweenStations, importantPoints, numOfUnits,
+                        stepBudget)) {
+        PrintError("Error: RunIsland couldn't initialize chromosomes.");
+        return;
+    }
+    SeedConstructedPlans(currentPopulation, populationSize, distances, importantPoints, numOfUnits, hostageStations,
+                         stepBudget);
+    if (island.runState->warmStartPlan != nullptr) {
+        SeedFromPreviousPlan(currentPopulation, populationSize, *island.runState->warmStartPlan, distances,
+                             importantPoints, hostageStations, stepBudget);
+    }
+    for (int i = 0; i < populationSize; ++i) {
+        CalculateFitnessCached(currentPopulation[i], pathsBetweenStations, distances, stepBudget, hostageStations,
+                               island.runState->fitnessCache, *island.counters);
+    }
+
+    // Only the first island reports progress, so the callback is never called from two threads at once
+    bool reportProgress = island.index == 0;
+    OperatorSelector selector;
+    InitOperatorSelector(selector, island.runState->options->neighbourMutation);
+    double lastBestFitness = -1;
+    int stagnantGenerations = 0;
+    bool stop = UpdateRunState(*island.runState, 0, GetFittestChromosome(currentPopulation, populationSize),
+                               lastBestFitness, stagnantGenerations, reportProgress);
+
+    for (int G = 0; G < island.runState->options->maxGenerations && !stop; ++G) {
+        Selection(currentPopulation, matingPool, populationSize);
+        Crossover(matingPool, offspringPopulation, populationSize, numOfUnits, distances, stepBudget);
+        Mutation(offspringPopulation, populationSize, importantPoints, numOfUnits, pathsBetweenStations, distances,
+                 island.runState->neighbours, stepBudget, hostageStations, selector, *island.counters);
+
+        // The island is a single pool task, so the offspring are improved and evaluated right here
+        for (int i = 0; i < populationSize; ++i) {
+            if (offspringPopulation[i] == nullptr) {
+                continue;
+            }
+            if (RandomInt() % 100 < MEMETIC_RATE) {
+                ImproveOffspring(offspringPopulation[i], importantPoints, pathsBetweenStations, distances, stepBudget,
+                                 hostageStations, RandomInt(), *island.counters);
+            }
+            if (offspringPopulation[i]->needsFitnessEvaluation) {
+                CalculateFitnessCached(offspringPopulation[i], pathsBetweenStations, distances, stepBudget,
+                                       hostageStations, island.runState->fitnessCache, *island.counters);
+            }
+        }
+        CreditMutations(offspringPopulation, populationSize, selector, *island.counters, reportProgress);
+
+        PerformElitismAndReplacement(currentPopulation, offspringPopulation, populationSize);
+
+        // Exchange elites with the neighbour islands
+        if ((G + 1) % MIGRATION_INTERVAL == 0) {
+            SendMigrants(island, currentPopulation);
+            ReceiveMigrants(island, currentPopulation);
+        }
+
+        stop = UpdateRunState(*island.runState, G + 1, GetFittestChromosome(currentPopulation, populationSize),
+                              lastBestFitness, stagnantGenerations, reportProgress);
     }
 
-    vector<vector<LocationID> > bestPlan = GetFittestChromosome(currentPopulation)->unitPaths;
+    island.best = new Chromosome(*GetFittestChromosome(currentPopulation, populationSize));
 
     // Deallocate population
-    DeallocateChromosomePopulation(currentPopulation);
+    DeallocateChromosomePopulation(currentPopulation, populationSize);
     free(matingPool);
     free(offspringPopulation);
+}
+
+// Run one island per pool thread, the islands send their elites to the next island in a ring
+vector<vector<LocationID> > RunIslandModel(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                           const vector<pair<LocationID, Point> > &importantPoints,
+                                           const DistanceMatrix &distances, int numOfUnits,
+                                           HostageStation **hostageStations, ThreadPool &pool, GARunState &state) {
+    int numOfIslands = static_cast<int>(std::max(1u, pool.GetThreadCount()));
+
+    // Split the population between the islands, but keep each one big enough to evolve
+    int islandPopulation = std::max(POPULATION_SIZE / numOfIslands, MIN_ISLAND_POPULATION);
+    islandPopulation += islandPopulation % 2; // Crossover works in pairs
+
+    vector<MigrationMailbox> mailboxes(numOfIslands);
+    vector<Island> islands(numOfIslands);
+    for (int i = 0; i < numOfIslands; ++i) {
+        state.islandCounters.emplace_back(new GACounters());
+        islands[i].index = i;
+        islands[i].populationSize = islandPopulation;
+        islands[i].runState = &state;
+        islands[i].inbox = &mailboxes[i];
+        islands[i].outbox = &mailboxes[(i + 1) % numOfIslands];
+        islands[i].counters = state.islandCounters.back().get();
+    }
+
+    // Each island is one task on the pool for the whole run, there is no barrier between generations.
+    // The islands only meet through the mailboxes, so they also finish when the pool runs them one after another.
+    if (pool.GetThreadCount() == 0) {
+        for (Island &island: islands) {
+            RunIsland(island, pathsBetweenStations, importantPoints, distances, numOfUnits, hostageStations);
+        }
+    } else {
+        TaskGroup islandTasks(pool);
+        for (int i = 0; i < numOfIslands; ++i) {
+            islandTasks.Run([&, i]() {
+                RunIsland(islands[i], pathsBetweenStations, importantPoints, distances, numOfUnits, hostageStations);
+            }, state.options->priority);
+        }
+        islandTasks.Wait();
+    }
+
+    // Delete the migrants no island got to take
+    for (MigrationMailbox &mailbox: mailboxes) {
+        while (Chromosome *migrant = mailbox.Pop()) {
+            delete migrant;
+        }
+    }
+
+    // Take the best plan of all islands
+    vector<vector<LocationID> > bestPlan;
+    double bestFitness = -1;
+    for (Island &island: islands) {
+        if (island.best != nullptr && island.best->fitness > bestFitness) {
+            bestFitness = island.best->fitness;
+            bestPlan = island.best->unitPaths;
+        }
+        delete island.best;
+    }
+
+    return bestPlan;
+}
+
+// Run the GA with the options, starting around the previous plan if one is given
+vector<vector<LocationID> > RunGA(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                  const vector<pair<LocationID, Point> > &importantPoints,
+                                  int numOfUnits, HostageStation **hostageStations, const GAOptions &options,
+                                  const vector<vector<LocationID> > *previousPlan, const GACheckpoint *resumeFrom) {
+    // Share the process pool unless told otherwise, the GA may itself be running on it as part of a sweep
+    ThreadPool &pool = options.pool != nullptr ? *options.pool : ThreadPool::Shared();
+
+    // Flat step costs between the important points, used by the local search and to order the final routes
+    DistanceMatrix ownDistances;
+    if (options.distances == nullptr) {
+        ownDistances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+    }
+    const DistanceMatrix &distances = options.distances != nullptr ? *options.distances : ownDistances;
+
+    // Track the best plan here if the caller doesn't want to
+    BestPlanTracker localBestSoFar;
+    GARunState state;
+    state.options = &options;
+    state.start = std::chrono::steady_clock::now();
+    state.upperBound = PValueUpperBound(distances, importantPoints, numOfUnits, hostageStations, options.stepBudget);
+    state.bestSoFar = options.bestSoFar != nullptr ? options.bestSoFar : &localBestSoFar;
+    state.neighbours = BuildNeighbourLists(distances, importantPoints, NEIGHBOUR_LIST_SIZE);
+    state.scenarioHash = ScenarioHash(pathsBetweenStations, importantPoints, hostageStations);
+
+    // The repaired plan is a valid answer already, even if the search gets no time at all
+    vector<vector<LocationID> > repairedPlan;
+    if (previousPlan != nullptr) {
+        repairedPlan = RepairPlan(*previousPlan, distances, importantPoints, numOfUnits, hostageStations,
+                                  options.stepBudget);
+        state.warmStartPlan = &repairedPlan;
+        state.bestSoFar->Offer(repairedPlan, SumPValue(repairedPlan, hostageStations));
+    }
+    if (resumeFrom != nullptr) {
+        state.resumeFrom = resumeFrom;
+        state.bestSoFar->Offer(resumeFrom->bestPlan, resumeFrom->bestFitness);
+    }
+    if (ISLAND_MODE && !options.checkpointPath.empty()) {
+        PrintWarning("Warning: MainAlgorithm can't checkpoint the island model, the run won't be saved\n");
+    }
+
+    vector<vector<LocationID> > bestPlan;
+    if (ISLAND_MODE) {
+        bestPlan = RunIslandModel(pathsBetweenStations, importantPoints, distances, numOfUnits, hostageStations,
+                                  pool, state);
+    } else {
+        bestPlan = RunSinglePopulation(pathsBetweenStations, importantPoints, distances, numOfUnits,
+                                       hostageStations, pool, state);
+    }
+    if (options.stats != nullptr) {
+        *options.stats = GetStats(state);
+    }
+    if (bestPlan.empty()) {
+        return bestPlan;
+    }
 
     // Improve any imperfections in the order of actions.
-    FindBestPathInPlanBruteForce(bestPlan, pathsBetweenStations);
+    FindBestPathInPlan(bestPlan, distances, pool, options.priority);
 
     // Return best plan found
     return bestPlan;
 }
+
+vector<vector<LocationID> > MainAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                          const vector<pair<LocationID, Point> > &importantPoints,
+                                          int numOfUnits, HostageStation **hostageStations) {
+    // Run all the generations without a deadline
+    return MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, GAOptions());
+}
+
+vector<vector<LocationID> > MainAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                          const vector<pair<LocationID, Point> > &importantPoints,
+                                          int numOfUnits, HostageStation **hostageStations,
+                                          const GAOptions &options) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: MainAlgorithm received in valid input");
+        return vector<vector<LocationID> >();
+    }
+
+    // Continue a saved run if there is one for this scenario
+    if (options.resume && !ISLAND_MODE) {
+        GACheckpoint checkpoint;
+        if (!LoadCheckpoint(checkpoint, options.checkpointPath)) {
+            PrintWarning("Warning: MainAlgorithm found no checkpoint in %s, starting a new run\n",
+                         options.checkpointPath.c_str());
+        } else if (!IsCheckpointCompatible(checkpoint, ScenarioHash(pathsBetweenStations, importantPoints,
+                                                                    hostageStations),
+                                           numOfUnits, options.stepBudget)) {
+            PrintWarning("Warning: MainAlgorithm can't resume from %s, it belongs to another scenario\n",
+                         options.checkpointPath.c_str());
+        } else {
+            return RunGA(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options, nullptr,
+                         &checkpoint);
+        }
+    }
+
+    return RunGA(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options, nullptr, nullptr);
+}
+
+vector<vector<LocationID> > ReplanAlgorithm(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                            const vector<pair<LocationID, Point> > &importantPoints,
+                                            int numOfUnits, HostageStation **hostageStations,
+                                            const vector<vector<LocationID> > &previousPlan,
+                                            const GAOptions &options) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || numOfUnits < 1 || hostageStations == nullptr) {
+        PrintError("Error: ReplanAlgorithm received in valid input");
+        return vector<vector<LocationID> >();
+    }
+
+    // Keep the search short, a small change should need only a few generations to settle.
+    // Someone is waiting for the new plan, so it goes ahead of the bulk work on the pool.
+    GAOptions replanOptions = options;
+    replanOptions.priority = HIGH_PRIORITY;
+    replanOptions.maxGenerations = std::min(options.maxGenerations, REPLAN_GENERATIONS);
+    if (replanOptions.maxStagnantGenerations <= 0 ||
+        replanOptions.maxStagnantGenerations > REPLAN_STAGNANT_GENERATIONS) {
+        replanOptions.maxStagnantGenerations = REPLAN_STAGNANT_GENERATIONS;
+    }
+
+    return RunGA(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, replanOptions, &previousPlan,
+                 nullptr);
+}
@@ -1,18 +1,30 @@
 ﻿//----INCLUDES--------------------------------------------------------
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <string.h>
 #include <Math.h>
 #include <iostream>
 #include <windows.h>
 #include <chrono>
+#include <algorithm>
 #include "include/MazeGenerator.h"
 #include "include/HostageStation.h"
 #include "include/BFS.h"
 #include "include/ThreadPool.h"
+#include "include/CpuTopology.h"
 #include "include/GeneticAlgorithm.h"
+#include "include/Planner.h"
+#include "include/Benchmark.h"
 #include "include/ConsoleManager.h"
 #include "include/Visualizer.h"
 
+//----CONSTANTS-------------------------------------------------------
+// Limits of the numeric options, well above any real machine so only typos and wrapped values are refused
+const long MAX_THREADS_OPTION = 1024;
+const long MAX_TELEMETRY_MILLISECONDS = 3600000; // An hour
+const double MAX_TARGET_PVALUE = 1e6;
+
 //----FUNCTION PROTOTYPES---------------------------------------------
 // Free all the space HS took.
 void DeallocateHostageStations(HostageStation **hostageStations, int numOfSections);
@@ -23,9 +35,9 @@ void printHostageStationInfo(HostageStation **hostageStations, int numOfSections
 void FillImportantPoints(vector<pair<LocationID, Point>> &importantPoints, HostageStation **hostageStations, int numberStations,
                          Point unitsEntrance); // Insert all location and ID of valuable HS and the unit entrance.
 
-// Remove all points that are not reachable from the entrance.
+// Remove all points that are not reachable from the entrance within the step budget.
 void RemoveUnreachablePoints(vector<pair<LocationID, Point>> &importantPoints,
-                        const map<PathKey, vector<Point> > &pathsBetweenStations);
+                        const map<PathKey, vector<Point> > &pathsBetweenStations, int stepBudget);
 
 // Show each unit HS
 void ShowPlan(vector<vector<LocationID> > plan, HostageStation **hostageStations);
@@ -33,14 +45,88 @@ void ShowPlan(vector<vector<LocationID> > plan, HostageStation **hostageStations
 // Show the plan the units will fallow
 void ExplainSigns(); // Explain the various marks and signs in the simulation
 
+// Print where the GA spent its evaluations and how the mutation operators did
+void PrintGAStats(const GAStats &gaStats);
+
+// Read the value of a numeric option, prints an error and returns false unless it is a whole number in
+// [minimum, maximum]
+bool ParseIntOption(const char *option, const char *text, long minimum, long maximum, int &value);
+
+// Same for an option that takes a decimal number
+bool ParseDoubleOption(const char *option, const char *text, double minimum, double maximum, double &value);
+
 //----FUNCTIONS-------------------------------------------------------
-int main() {
+int main(int argc, char *argv[]) {
+    // Choose the planner: "--fast" skips the search and answers with the insertion heuristics,
+    // "--alns" runs the ALNS instead of the GA and "--portfolio" runs both at once.
+    // "--sweep" plans every budget and unit count in SWEEP_BUDGETS x SWEEP_UNIT_COUNTS and prints a table.
+    // "--benchmark" times the thread pool on the generated scenario instead of planning.
+    // "--target P" stops the planner once a plan reaches PValue P and prints how long it took. With "--benchmark"
+    // it is the PValue the time-to-target table aims for.
+    // The pool: "--threads N" sets the thread count, "--pin" pins each thread to a core, "--no-smt" pins only to
+    // one logical core per physical core and "--reserve-core C" keeps core C for the console thread.
+    // "--telemetry MS" appends the telemetry of the pool to PoolTelemetry.log every MS milliseconds.
+    // "--lock-free" gives the pool one lock-free queue instead of the work stealing deques.
+    PlannerType planner = GA_PLANNER;
+    bool sweep = false;
+    bool benchmark = false;
+    double targetFitness = -1;
+    PoolConfig poolConfig;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--fast") == 0) {
+            planner = FAST_PLANNER;
+        } else if (strcmp(argv[i], "--alns") == 0) {
+            planner = ALNS_PLANNER;
+        } else if (strcmp(argv[i], "--portfolio") == 0) {
+            planner = PORTFOLIO_PLANNER;
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmark = true;
+        } else if (strcmp(argv[i], "--target") == 0 && i + 1 < argc) {
+            if (!ParseDoubleOption("--target", argv[++i], 0, MAX_TARGET_PVALUE, targetFitness)) {
+                getchar();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int numOfThreads;
+            if (!ParseIntOption("--threads", argv[++i], 0, MAX_THREADS_OPTION, numOfThreads)) {
+                getchar();
+                return -1;
+            }
+            poolConfig.num_threads = numOfThreads;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            poolConfig.pin_threads = true;
+        } else if (strcmp(argv[i], "--no-smt") == 0) {
+            poolConfig.pin_threads = true;
+            poolConfig.skip_smt_siblings = true;
+        } else if (strcmp(argv[i], "--reserve-core") == 0 && i + 1 < argc) {
+            if (!ParseIntOption("--reserve-core", argv[++i], -1, MAX_THREADS_OPTION - 1, poolConfig.reserved_core)) {
+                getchar();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--lock-free") == 0) {
+            poolConfig.scheduler = LOCK_FREE_QUEUE_SCHEDULER;
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            if (!ParseIntOption("--telemetry", argv[++i], 0, MAX_TELEMETRY_MILLISECONDS,
+                                poolConfig.telemetry_dump_milliseconds)) {
+                getchar();
+                return -1;
+            }
+            poolConfig.telemetry_file = "PoolTelemetry.log";
+        }
+    }
+    ThreadPool::ConfigureShared(poolConfig);
+
     // prep
     system("CLS"); // Clear console
     auto startProgram = std::chrono::high_resolution_clock::now();
     srand(time(0)); // seed random number generator.
     // Set the console on a separate thread
     thread consoleThread(SetConsole);
+    if (poolConfig.reserved_core >= 0 && !PinThreadToCore(consoleThread, poolConfig.reserved_core)) {
+        PrintWarning("Warning: couldn't pin the console thread to core %d\n", poolConfig.reserved_core);
+    }
 
     // variables
     char **grid = AllocateGrid();
@@ -86,30 +172,62 @@ int main() {
     // Add a mutex to protect the map from concurrent access
     std::mutex pathMapMutex;
 
-    // Create a thread pool with hardware_concurrency threads (number of cores in CPU)
-    ThreadPool pool(std::thread::hardware_concurrency());
+    // The process pool, a thread per core (number of cores in CPU) unless the flags said otherwise
+    ThreadPool &pool = ThreadPool::Shared();
 
-    // Find the best path between each one of the important points
-    for (LocationID i = 0; i < importantPoints.size(); i++) {
-        // Capture i by value to avoid issues with the loop variables changing
-        pool.Enqueue([i, &grid, &importantPoints, &pathsBetweenStations, &pathMapMutex]() {
-            // Calculate the path
-            BFS(grid, importantPoints[i].first, importantPoints[i].second, importantPoints,  pathsBetweenStations, pathMapMutex);
-        });
-    }
-
-    // Wait for all tasks to complete before proceeding
-    pool.WaitAll();
+    // Find the best path between each one of the important points, one source per chunk since each BFS is long
+    pool.ParallelFor(0, static_cast<int>(importantPoints.size()), 1, [&](int i) {
+        // Calculate the path
+        BFS(grid, importantPoints[i].first, importantPoints[i].second, importantPoints,  pathsBetweenStations, pathMapMutex);
+    });
 
     // End Path finding time and print it
     auto endPathFinding = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsedIteration = endPathFinding - startProgram;
     printf("Simulation environment creation & Path finding execution time: %f seconds\n", elapsedIteration.count());
 
+    if (benchmark) {
+        RemoveUnreachablePoints(importantPoints, pathsBetweenStations, UNIT_STEP_BUDGET);
+        RunBenchmarks(grid, pathsBetweenStations, importantPoints, numOfUnits, hostageStations, targetFitness);
+
+        consoleThread.join();
+        printf("Benchmark finished, please press enter to finish the program");
+        getchar();
+        DeallocateGrid(grid);
+        DeallocateHostageStations(hostageStations, numOfSections);
+        return 0;
+    }
+
+    if (sweep) {
+        // Keep the stations the biggest budget can reach, each run checks its own budget
+        vector<int> stepBudgets(std::begin(SWEEP_BUDGETS), std::end(SWEEP_BUDGETS));
+        vector<int> unitCounts(std::begin(SWEEP_UNIT_COUNTS), std::end(SWEEP_UNIT_COUNTS));
+        RemoveUnreachablePoints(importantPoints, pathsBetweenStations,
+                                *std::max_element(stepBudgets.begin(), stepBudgets.end()));
+
+        auto startSweep = std::chrono::high_resolution_clock::now();
+        vector<SweepResult> results = RunBudgetSweep(planner, pathsBetweenStations, importantPoints, hostageStations,
+                                                     stepBudgets, unitCounts, pool);
+        elapsedIteration = std::chrono::high_resolution_clock::now() - startSweep;
+        PrintSweepTable(results, elapsedIteration.count());
+
+        consoleThread.join();
+        printf("Sweep finished, please press enter to finish the program");
+        getchar();
+        DeallocateGrid(grid);
+        DeallocateHostageStations(hostageStations, numOfSections);
+        return 0;
+    }
+
     // Main algorithm
-    RemoveUnreachablePoints(importantPoints, pathsBetweenStations);
+    RemoveUnreachablePoints(importantPoints, pathsBetweenStations, UNIT_STEP_BUDGET);
     auto startGA = std::chrono::high_resolution_clock::now();
-    vector<vector<LocationID> > answer = MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations);
+    GAStats gaStats;
+    GAOptions gaOptions;
+    gaOptions.stats = &gaStats;
+    gaOptions.targetFitness = targetFitness;
+    vector<vector<LocationID> > answer = RunPlanner(planner, pathsBetweenStations, importantPoints, numOfUnits,
+                                                    hostageStations, gaOptions);
     if (answer.empty()) {
         PrintError("Error: Failed to creat an answer using the GA. Exiting.\n");
         getchar();
@@ -118,10 +236,30 @@ int main() {
     // Print GA running execution time
     auto endGA = std::chrono::high_resolution_clock::now();
     elapsedIteration = endGA - startGA;
-    printf("\nGenetic algorithm execution time: %f seconds\n", elapsedIteration.count());
+    const char *plannerNames[] = {"Genetic algorithm", "Fast plan", "ALNS", "GA and ALNS portfolio"};
+    printf("\n%s execution time: %f seconds\n", plannerNames[planner], elapsedIteration.count());
+    if (planner == GA_PLANNER || planner == PORTFOLIO_PLANNER) {
+        PrintGAStats(gaStats);
+    }
+    if (planner == PORTFOLIO_PLANNER) {
+        const char *engineNames[] = {"GA", "ALNS"};
+        printf("Best plan offered by the %s\n", engineNames[gaStats.bestEngine]);
+    }
+    if (targetFitness >= 0 && planner != FAST_PLANNER) {
+        if (gaStats.secondsToTarget >= 0) {
+            printf("Target PValue %.2f reached after %.3f seconds\n", targetFitness, gaStats.secondsToTarget);
+        } else {
+            printf("Target PValue %.2f not reached\n", targetFitness);
+        }
+    }
 
-    // Print total PValue
-    printf("Total PValue for the mission: %.2f\n", SumPValue(answer, hostageStations));
+    // Print total PValue and how far it can be from the best possible plan
+    double totalPValue = SumPValue(answer, hostageStations);
+    double upperBound = PValueUpperBound(pathsBetweenStations, importantPoints, numOfUnits, hostageStations,
+                                         UNIT_STEP_BUDGET);
+    double optimalityGap = upperBound > 0 ? (upperBound - totalPValue) / upperBound * 100 : 0;
+    printf("Total PValue for the mission: %.2f (upper bound: %.2f, optimality gap: %.2f%%)\n", totalPValue, upperBound,
+           optimalityGap);
 
     // Wait for the console thread to finish
     consoleThread.join();
@@ -165,7 +303,8 @@ void FillImportantPoints(vector<pair<LocationID, Point>> &importantPoints, Hosta
     }
 }
 
-void RemoveUnreachablePoints(vector<pair<LocationID, Point>> &importantPoints, const map<PathKey, vector<Point> > &pathsBetweenStations) {
+void RemoveUnreachablePoints(vector<pair<LocationID, Point>> &importantPoints, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                             int stepBudget) {
     if (importantPoints.empty()) {
         return;
     }
@@ -178,7 +317,7 @@ void RemoveUnreachablePoints(vector<pair<LocationID, Point>> &importantPoints, c
     for (int i = 1; i < importantPoints.size(); i++) {
         int distance = GetPathCost(importantPoints[0].first, importantPoints[i].first, pathsBetweenStations);
         // Insert only reachable stations
-        if (distance && distance <= UNIT_STEP_BUDGET) {
+        if (distance && distance <= stepBudget) {
             reachablePoints.push_back(importantPoints.at(i));
         }
     }
@@ -251,3 +390,48 @@ void PrintHostageStationInfo(HostageStation **hostageStations, int numOfSections
         hostageStations[i]->PrintInfo();
     }
 }
+
+void PrintGAStats(const GAStats &gaStats) {
+    printf("Fitness evaluations: %lld (%.2f%% on invalid plans)\n", gaStats.evaluations,
+           gaStats.InvalidEvaluationRate() * 100);
+    printf("Fitness cache hits: %lld of %lld lookups (%.2f%%)\n", gaStats.cacheHits, gaStats.cacheLookups,
+           gaStats.CacheHitRate() * 100);
+
+    // Print how each mutation operator did, used to tune the operator selection
+    const char *operatorNames[NUM_OF_MUTATION_OPERATORS] = {"Add station", "Remove station", "Swap in unit",
+                                                            "Swap between units", "Add neighbour",
+                                                            "Swap neighbour"};
+    for (int o = 0; o < NUM_OF_MUTATION_OPERATORS; ++o) {
+        const MutationOperatorStats &operatorStats = gaStats.mutationOperators[o];
+        printf("%-20s used %6lld, changed %6lld, accepted %.2f%%, improved %5lld (%.2f%%), gain %.2f, %.4f s, "
+               "final chance %.2f%%\n", operatorNames[o], operatorStats.applications, operatorStats.changes,
+               operatorStats.AcceptanceRate() * 100, operatorStats.improvements, operatorStats.SuccessRate() * 100,
+               operatorStats.totalGain, operatorStats.seconds, operatorStats.probability * 100);
+    }
+    printf("Mutation acceptance rate: %.2f%%\n", gaStats.MutationAcceptanceRate() * 100);
+}
+
+bool ParseIntOption(const char *option, const char *text, long minimum, long maximum, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < minimum || parsed > maximum) {
+        PrintError("Error: %s received \"%s\", expected a whole number from %ld to %ld.\n", option, text, minimum,
+                   maximum);
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool ParseDoubleOption(const char *option, const char *text, double minimum, double maximum, double &value) {
+    char *end = nullptr;
+    errno = 0;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !(parsed >= minimum && parsed <= maximum)) {
+        PrintError("Error: %s received \"%s\", expected a number from %g to %g.\n", option, text, minimum, maximum);
+        return false;
+    }
+    value = parsed;
+    return true;
+}
@@ -0,0 +1,145 @@
+#include "include/ParallelRegion.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+ParallelRegion::ParallelRegion(ThreadPool &pool, bool persistent, TaskPriority priority)
+        : pool_(pool), priority_(priority), team_(pool)
+{
+    // A region made on a pool thread would wait for the threads of the busy pool, let the pool run its steps
+    unsigned int num_threads = pool.GetThreadCount();
+    if (!persistent || num_threads == 0 || pool.IsPoolThread()) {
+        return;
+    }
+
+    if (std::thread::hardware_concurrency() <= 1) {
+        spin_time_ = std::chrono::microseconds(0);
+    }
+    persistent_ = true;
+    team_size_ = static_cast<int>(num_threads);
+    chunks_per_step_ = (team_size_ + 1) * PARALLEL_CHUNKS_PER_THREAD;
+}
+
+ParallelRegion::~ParallelRegion()
+{
+    if (!persistent_) {
+        return;
+    }
+
+    // The spinning team threads see the flag and leave, the ones that didn't start yet leave as they start
+    stop_.store(true, std::memory_order_seq_cst);
+    team_.Wait();
+}
+
+void ParallelRegion::TeamLoop(long long seen_step)
+{
+    while (true) {
+        bool ready = SpinUntil([this, seen_step]() {
+            return step_number_.load(std::memory_order_acquire) != seen_step ||
+                   stop_.load(std::memory_order_relaxed);
+        }, std::chrono::steady_clock::now() + spin_time_);
+        if (stop_.load(std::memory_order_relaxed)) {
+            members_.fetch_sub(1, std::memory_order_seq_cst);
+            return;
+        }
+
+        if (!ready) {
+            // Leave, but look once more: a step published before the count went down didn't hire anyone for us.
+            // The seq_cst pair with RunStep makes sure that step either sees the lower count or we see the step.
+            members_.fetch_sub(1, std::memory_order_seq_cst);
+            if (step_number_.load(std::memory_order_seq_cst) == seen_step) {
+                leave_count_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            members_.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        std::shared_ptr<Step> step;
+        {
+            std::unique_lock<std::mutex> lock(step_mutex_);
+            step = current_step_;
+        }
+        seen_step = step->number;
+        TakeChunks(*step);
+    }
+}
+
+void ParallelRegion::RunStep(int num_chunks, const std::function<void(int)> &chunk)
+{
+    std::shared_ptr<Step> step = std::make_shared<Step>();
+    step->num_chunks = num_chunks;
+    step->chunk = &chunk;
+    {
+        std::unique_lock<std::mutex> lock(step_mutex_);
+        step->number = step_number_.load(std::memory_order_relaxed) + 1;
+        current_step_ = step;
+    }
+    step_number_.store(step->number, std::memory_order_seq_cst);
+
+    // Hire the pool threads that went back to the pool, they join this step when they start
+    int missing = team_size_ - members_.load(std::memory_order_seq_cst);
+    for (int i = 0; i < missing; ++i) {
+        members_.fetch_add(1, std::memory_order_relaxed);
+        long long seen_step = step->number - 1;
+        team_.Run([this, seen_step]() {
+            TeamLoop(seen_step);
+        }, priority_);
+    }
+
+    // chunk lives on our stack, a team thread only calls it for a chunk it took, and we wait for all of those
+    TakeChunks(*step);
+    auto all_done = [&step]() {
+        return step->done.load(std::memory_order_acquire) == step->num_chunks;
+    };
+    if (SpinUntil(all_done, std::chrono::steady_clock::now() + spin_time_)) {
+        return;
+    }
+
+    // A long chunk is still running, sleep instead of burning a core the pool could use
+    std::unique_lock<std::mutex> lock(step->mutex);
+    step->done_cv.wait(lock, all_done);
+}
+
+void ParallelRegion::TakeChunks(Step &step)
+{
+    while (true) {
+        int c = step.next.fetch_add(1, std::memory_order_relaxed);
+        if (c >= step.num_chunks) {
+            return;
+        }
+        (*step.chunk)(c);
+
+        // The last chunk wakes the caller, the lock makes sure it waits or will see the count
+        if (step.done.fetch_add(1, std::memory_order_acq_rel) + 1 == step.num_chunks) {
+            {
+                std::unique_lock<std::mutex> lock(step.mutex);
+            }
+            step.done_cv.notify_all();
+        }
+    }
+}
+
+bool ParallelRegion::SpinUntil(const std::function<bool()> &ready, std::chrono::steady_clock::time_point deadline)
+{
+    int pauses = 1;
+    while (!ready()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+
+        // Back off so the spinning threads don't flood the cache line of the step, then let other threads run
+        for (int i = 0; i < pauses; ++i) {
+            CPU_RELAX();
+        }
+        if (pauses < REGION_MAX_PAUSES) {
+            pauses *= 2;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
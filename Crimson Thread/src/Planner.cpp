@@ -0,0 +1,89 @@
+//----INCLUDES--------------------------------------------------------
+#include <chrono>
+#include <cstdio>
+#include "include/Planner.h"
+#include "include/ALNS.h"
+#include "include/Construction.h"
+#include "include/RouteOptimizer.h"
+#include "include/Visualizer.h"
+
+//----FUNCTIONS-------------------------------------------------------
+vector<vector<LocationID> > RunPlanner(PlannerType planner, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                       const vector<pair<LocationID, Point> > &importantPoints, int numOfUnits,
+                                       HostageStation **hostageStations, const GAOptions &options) {
+    switch (planner) {
+        case FAST_PLANNER:
+            if (options.distances != nullptr) {
+                return FastPlan(*options.distances, importantPoints, numOfUnits, hostageStations, options.stepBudget);
+            }
+            return FastPlan(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options.stepBudget);
+        case ALNS_PLANNER:
+            return ALNSAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+        case PORTFOLIO_PLANNER:
+            return PortfolioAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+        case GA_PLANNER:
+            return MainAlgorithm(pathsBetweenStations, importantPoints, numOfUnits, hostageStations, options);
+        default:
+            PrintError("Error: RunPlanner received unknown planner %d\n", planner);
+            return vector<vector<LocationID> >();
+    }
+}
+
+vector<SweepResult> RunBudgetSweep(PlannerType planner, const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                   const vector<pair<LocationID, Point> > &importantPoints,
+                                   HostageStation **hostageStations, const vector<int> &stepBudgets,
+                                   const vector<int> &unitCounts, ThreadPool &pool,
+                                   const CancellationToken &cancel) {
+    if (pathsBetweenStations.empty() || importantPoints.empty() || hostageStations == nullptr) {
+        PrintError("Error: RunBudgetSweep received in valid input");
+        return vector<SweepResult>();
+    }
+
+    // Step costs depend only on the paths, every row shares them
+    DistanceMatrix distances = BuildDistanceMatrix(pathsBetweenStations, importantPoints);
+
+    // Each task writes only its own row, so the table needs no locking
+    vector<SweepResult> results(stepBudgets.size() * unitCounts.size());
+    TaskGroup group(pool, CancellationToken::Clock::time_point::max(), cancel);
+    for (int b = 0; b < stepBudgets.size(); ++b) {
+        for (int u = 0; u < unitCounts.size(); ++u) {
+            SweepResult &result = results[b * unitCounts.size() + u];
+            result.stepBudget = stepBudgets[b];
+            result.numOfUnits = unitCounts[u];
+
+            group.Run([planner, &result, &pathsBetweenStations, &importantPoints, hostageStations, &distances,
+                       &pool, &group]() {
+                GAOptions options;
+                options.stepBudget = result.stepBudget;
+                options.distances = &distances;
+                options.pool = &pool;
+                options.cancel = group.GetToken();
+
+                auto start = std::chrono::steady_clock::now();
+                result.plan = RunPlanner(planner, pathsBetweenStations, importantPoints, result.numOfUnits,
+                                         hostageStations, options);
+                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                result.pValue = SumPValue(result.plan, hostageStations);
+                result.upperBound = PValueUpperBound(distances, importantPoints, result.numOfUnits, hostageStations,
+                                                     result.stepBudget);
+            });
+        }
+    }
+
+    // Wait for all the configurations to finish, the GA runs of the sweep use the same pool meanwhile
+    group.Wait();
+    return results;
+}
+
+void PrintSweepTable(const vector<SweepResult> &results, double totalSeconds) {
+    printf("\n%8s %6s %10s %12s %8s %10s\n", "Budget", "Units", "PValue", "Upper bound", "Gap", "Time (s)");
+    double sumSeconds = 0;
+    for (const SweepResult &result: results) {
+        double gap = result.upperBound > 0 ? (result.upperBound - result.pValue) / result.upperBound * 100 : 0;
+        printf("%8d %6d %10.2f %12.2f %7.2f%% %10.3f\n", result.stepBudget, result.numOfUnits, result.pValue,
+               result.upperBound, gap, result.seconds);
+        sumSeconds += result.seconds;
+    }
+    printf("Sweep took %.3f seconds (%.3f seconds of planner time)\n", totalSeconds, sumSeconds);
+}
@@ -0,0 +1,94 @@
+#include "include/PoolTelemetry.h"
+#include "include/ThreadPool.h"
+
+void HistogramSnapshot::Merge(const HistogramSnapshot &other)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    max = (std::max)(max, other.max);
+}
+
+long long HistogramSnapshot::Percentile(double fraction) const
+{
+    if (total == 0) {
+        return 0;
+    }
+    long long rank = (std::max)(1LL, static_cast<long long>(fraction * total + 0.5));
+    long long seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The top of the bucket, but never above the largest value that was recorded
+            return (std::min)(Histogram::BucketLimit(i), max);
+        }
+    }
+    return max;
+}
+
+HistogramSnapshot Histogram::Snapshot() const
+{
+    HistogramSnapshot snapshot;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.total += snapshot.counts[i];
+    }
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+long long Histogram::BucketLimit(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    long long sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+// One row of the histogram table, the values are divided by scale
+static void PrintHistogramRow(FILE *file, const char *name, const HistogramSnapshot &histogram, double scale)
+{
+    fprintf(file, "%-16s %10lld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, histogram.total,
+            histogram.Mean() / scale, histogram.Percentile(0.5) / scale, histogram.Percentile(0.9) / scale,
+            histogram.Percentile(0.99) / scale, histogram.Percentile(0.999) / scale, histogram.max / scale);
+}
+
+void PrintPoolTelemetry(const PoolTelemetry &telemetry, FILE *file)
+{
+    if (file == nullptr) {
+        return;
+    }
+
+    fprintf(file, "Pool telemetry after %.1f ms: %d threads, %d tasks queued, %d not finished\n",
+            telemetry.uptime_milliseconds, static_cast<int>(telemetry.workers.size()), telemetry.queued_tasks,
+            telemetry.active_tasks);
+    fprintf(file, "%-8s %6s %10s %10s %12s %12s %8s\n", "Thread", "Core", "Tasks", "Steals", "Busy (ms)",
+            "Idle (ms)", "Busy %");
+    for (size_t i = 0; i < telemetry.workers.size(); ++i) {
+        const WorkerTelemetry &worker = telemetry.workers[i];
+        double busy = telemetry.uptime_milliseconds > 0
+                      ? 100 * worker.busy_milliseconds / telemetry.uptime_milliseconds : 0;
+        fprintf(file, "%-8d %6d %10lld %10lld %12.1f %12.1f %8.1f\n", static_cast<int>(i), worker.core,
+                worker.tasks, worker.steals, worker.busy_milliseconds, worker.idle_milliseconds, busy);
+    }
+
+    fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s %10s\n", "Histogram", "Count", "Mean", "p50", "p90", "p99",
+            "p99.9", "Max");
+    if (telemetry.queue_wait.size() == NUM_OF_TASK_PRIORITIES) {
+        PrintHistogramRow(file, "High wait (us)", telemetry.queue_wait[HIGH_PRIORITY], 1e3);
+        PrintHistogramRow(file, "Low wait (us)", telemetry.queue_wait[LOW_PRIORITY], 1e3);
+    }
+    PrintHistogramRow(file, "Run (us)", telemetry.run_time, 1e3);
+    PrintHistogramRow(file, "Queue depth", telemetry.queue_depth, 1);
+    if (telemetry.shared_queue_depth.size() == NUM_OF_TASK_PRIORITIES) {
+        fprintf(file, "Shared queues now: %d high priority, %d low priority\n",
+                telemetry.shared_queue_depth[HIGH_PRIORITY], telemetry.shared_queue_depth[LOW_PRIORITY]);
+    }
+    fprintf(file, "\n");
+    fflush(file);
+}
@@ -0,0 +1,365 @@
+//----INCLUDES--------------------------------------------------------
+#include <algorithm>
+#include <climits>
+#include "include/RouteOptimizer.h"
+#include "include/Visualizer.h"
+
+//----FUNCTIONS-------------------------------------------------------
+DistanceMatrix BuildDistanceMatrix(const map<PathKey, vector<Point> > &pathsBetweenStations,
+                                   const vector<pair<LocationID, Point> > &importantPoints) {
+    DistanceMatrix distances;
+    if (importantPoints.empty()) {
+        PrintError("Error: BuildDistanceMatrix received empty importantPoints\n");
+        return distances;
+    }
+
+    // The matrix must be big enough to index the highest ID
+    LocationID maxID = -1;
+    for (const pair<LocationID, Point> &point: importantPoints) {
+        maxID = std::max(maxID, point.first);
+    }
+    distances.size = maxID + 2;
+    distances.costs.assign(distances.size * distances.size, -1);
+
+    for (int i = 0; i < importantPoints.size(); ++i) {
+        LocationID id1 = importantPoints[i].first;
+        distances.costs[(id1 + 1) * distances.size + (id1 + 1)] = 0;
+
+        for (int j = i + 1; j < importantPoints.size(); ++j) {
+            LocationID id2 = importantPoints[j].first;
+            auto it = pathsBetweenStations.find(MakeKey(id1, id2));
+            if (it == pathsBetweenStations.end() || it->second.empty()) {
+                // Leave as unknown, the planners treat it as unreachable
+                continue;
+            }
+
+            // Cost is the number of steps, which is path length (number of cells) - 1
+            int cost = static_cast<int>(it->second.size()) - 1;
+            distances.costs[(id1 + 1) * distances.size + (id2 + 1)] = cost;
+            distances.costs[(id2 + 1) * distances.size + (id1 + 1)] = cost;
+        }
+    }
+
+    return distances;
+}
+
+NeighbourLists BuildNeighbourLists(const DistanceMatrix &distances,
+                                   const vector<pair<LocationID, Point> > &importantPoints, int listSize) {
+    NeighbourLists neighbours(distances.size);
+    if (distances.size == 0 || listSize < 1) {
+        PrintError("Error: BuildNeighbourLists received invalid parameters\n");
+        return neighbours;
+    }
+
+    for (const pair<LocationID, Point> &point: importantPoints) {
+        // Every other station with a known path, as (cost, ID) so ties go to the lower ID
+        vector<pair<int, LocationID> > candidates;
+        for (const pair<LocationID, Point> &other: importantPoints) {
+            int cost = distances.GetCost(point.first, other.first);
+            if (other.first != point.first && other.first != -1 && cost != -1) {
+                candidates.emplace_back(cost, other.first);
+            }
+        }
+
+        int numToKeep = std::min(listSize, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + numToKeep, candidates.end());
+
+        vector<LocationID> &list = neighbours[point.first + 1];
+        for (int k = 0; k < numToKeep; ++k) {
+            list.push_back(candidates[k].second);
+        }
+    }
+
+    return neighbours;
+}
+
+int PathDistance(const vector<LocationID> &path, const DistanceMatrix &distances) {
+    int pathLength = 0;
+
+    // Sum the total distance between each Point in the unit path
+    for (int s = 1; s < path.size(); ++s) {
+        int segmentLength = distances.GetCost(path[s - 1], path[s]);
+        if (segmentLength == -1) {
+            return -1;
+        }
+        pathLength += segmentLength;
+    }
+
+    return pathLength;
+}
+
+void OrderPathHeldKarp(vector<LocationID> &path, const DistanceMatrix &distances) {
+    int numOfStops = static_cast<int>(path.size()) - 1;
+    if (numOfStops < 2) {
+        // Nothing to order
+        return;
+    }
+    if (numOfStops > HELD_KARP_MAX_STOPS) {
+        PrintError("Error: OrderPathHeldKarp received a path with too many stations (%d)\n", numOfStops);
+        return;
+    }
+
+    LocationID entrance = path.front();
+    const LocationID *stops = path.data() + 1;
+    int fullMask = (1 << numOfStops) - 1;
+
+    // bestCost[mask * n + j] = shortest walk from the entrance visiting the stops in mask and ending at stop j
+    vector<int> bestCost((fullMask + 1) * numOfStops, INT_MAX);
+    vector<signed char> previousStop((fullMask + 1) * numOfStops, -1);
+
+    for (int j = 0; j < numOfStops; ++j) {
+        int cost = distances.GetCost(entrance, stops[j]);
+        if (cost != -1) {
+            bestCost[(1 << j) * numOfStops + j] = cost;
+        }
+    }
+
+    // Masks only grow, so going over them in increasing order visits every sub-mask first
+    for (int mask = 1; mask <= fullMask; ++mask) {
+        for (int last = 0; last < numOfStops; ++last) {
+            int currentCost = bestCost[mask * numOfStops + last];
+            if (!(mask & (1 << last)) || currentCost == INT_MAX) {
+                continue;
+            }
+
+            // Try to extend the walk to each of the stops not visited yet
+            for (int next = 0; next < numOfStops; ++next) {
+                if (mask & (1 << next)) {
+                    continue;
+                }
+                int segmentLength = distances.GetCost(stops[last], stops[next]);
+                if (segmentLength == -1) {
+                    continue;
+                }
+
+                int nextIndex = (mask | (1 << next)) * numOfStops + next;
+                if (currentCost + segmentLength < bestCost[nextIndex]) {
+                    bestCost[nextIndex] = currentCost + segmentLength;
+                    previousStop[nextIndex] = static_cast<signed char>(last);
+                }
+            }
+        }
+    }
+
+    // The unit doesn't return to the entrance, so the walk can end at any stop
+    int bestLast = -1;
+    for (int j = 0; j < numOfStops; ++j) {
+        if (bestCost[fullMask * numOfStops + j] != INT_MAX &&
+            (bestLast == -1 || bestCost[fullMask * numOfStops + j] < bestCost[fullMask * numOfStops + bestLast])) {
+            bestLast = j;
+        }
+    }
+    if (bestLast == -1) {
+        PrintWarning("Warning: OrderPathHeldKarp couldn't find a connected order for the path\n");
+        return;
+    }
+
+    // Walk back through the parents to rebuild the order
+    vector<LocationID> orderedPath(path.size());
+    orderedPath[0] = entrance;
+    int mask = fullMask;
+    int current = bestLast;
+    for (int position = numOfStops; position >= 1; --position) {
+        orderedPath[position] = stops[current];
+        int previous = previousStop[mask * numOfStops + current];
+        mask &= ~(1 << current);
+        current = previous;
+    }
+
+    path.swap(orderedPath);
+}
+
+// Get the cost between two positions of the path, missing segments count as unreachable
+static int SegmentCost(const vector<LocationID> &path, int from, int to, const DistanceMatrix &distances) {
+    int cost = distances.GetCost(path[from], path[to]);
+    return cost == -1 ? INT_MAX / 4 : cost;
+}
+
+int InsertionCost(const vector<LocationID> &path, int position, LocationID station, const DistanceMatrix &distances) {
+    if (position < 1 || position > path.size()) {
+        PrintError("Error: InsertionCost received invalid position %d\n", position);
+        return INT_MAX / 4;
+    }
+
+    int toStation = distances.GetCost(path[position - 1], station);
+    if (toStation == -1) {
+        return INT_MAX / 4;
+    }
+    if (position == path.size()) {
+        // Appended at the end, there is no segment to replace
+        return toStation;
+    }
+
+    int fromStation = distances.GetCost(station, path[position]);
+    int skipped = distances.GetCost(path[position - 1], path[position]);
+    if (fromStation == -1 || skipped == -1) {
+        return INT_MAX / 4;
+    }
+    return toStation + fromStation - skipped;
+}
+
+int RemovalGain(const vector<LocationID> &path, int index, const DistanceMatrix &distances) {
+    if (index < 1 || index >= path.size()) {
+        PrintError("Error: RemovalGain received invalid index %d\n", index);
+        return 0;
+    }
+
+    int gain = SegmentCost(path, index - 1, index, distances);
+    if (index + 1 < path.size()) {
+        gain += SegmentCost(path, index, index + 1, distances) - SegmentCost(path, index - 1, index + 1, distances);
+    }
+    return gain;
+}
+
+bool TryTwoOpt(vector<LocationID> &path, const DistanceMatrix &distances) {
+    int last = static_cast<int>(path.size()) - 1;
+
+    for (int i = 1; i < last; ++i) {
+        for (int j = i + 1; j <= last; ++j) {
+            // Reversing path[i..j] only changes the edges at both of its ends
+            int removed = SegmentCost(path, i - 1, i, distances);
+            int added = SegmentCost(path, i - 1, j, distances);
+            if (j < last) {
+                removed += SegmentCost(path, j, j + 1, distances);
+                added += SegmentCost(path, i, j + 1, distances);
+            }
+
+            if (added < removed) {
+                std::reverse(path.begin() + i, path.begin() + j + 1);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool TryOrOpt(vector<LocationID> &path, const DistanceMatrix &distances) {
+    int last = static_cast<int>(path.size()) - 1;
+
+    for (int length = 1; length <= OR_OPT_MAX_SEGMENT; ++length) {
+        for (int start = 1; start + length - 1 <= last; ++start) {
+            int end = start + length - 1;
+
+            // Steps saved by taking the chain out of the path
+            int removeGain = SegmentCost(path, start - 1, start, distances);
+            if (end < last) {
+                removeGain += SegmentCost(path, end, end + 1, distances)
+                        - SegmentCost(path, start - 1, end + 1, distances);
+            }
+
+            vector<LocationID> rest(path.begin(), path.begin() + start);
+            rest.insert(rest.end(), path.begin() + end + 1, path.end());
+            vector<LocationID> chain(path.begin() + start, path.begin() + end + 1);
+
+            // Try to put the chain after each position of the remaining path, in both directions
+            for (int position = 0; position < rest.size(); ++position) {
+                if (position == start - 1) {
+                    continue; // That's where the chain came from
+                }
+                for (int reversed = 0; reversed < 2; ++reversed) {
+                    LocationID first = reversed ? chain.back() : chain.front();
+                    LocationID tail = reversed ? chain.front() : chain.back();
+
+                    int insertCost = distances.GetCost(rest[position], first);
+                    if (insertCost == -1) {
+                        continue;
+                    }
+                    if (position + 1 < rest.size()) {
+                        int toNext = distances.GetCost(tail, rest[position + 1]);
+                        int skipped = distances.GetCost(rest[position], rest[position + 1]);
+                        if (toNext == -1 || skipped == -1) {
+                            continue;
+                        }
+                        insertCost += toNext - skipped;
+                    }
+
+                    if (insertCost < removeGain) {
+                        if (reversed) {
+                            std::reverse(chain.begin(), chain.end());
+                        }
+                        rest.insert(rest.begin() + position + 1, chain.begin(), chain.end());
+                        path.swap(rest);
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void OrderPathLocalSearch(vector<LocationID> &path, const DistanceMatrix &distances) {
+    if (path.size() < 3) {
+        // Nothing to order
+        return;
+    }
+
+    // Start from a greedy nearest neighbour order if it is better than the one we got
+    vector<LocationID> greedyPath;
+    greedyPath.push_back(path.front());
+    vector<LocationID> remaining(path.begin() + 1, path.end());
+    while (!remaining.empty()) {
+        int nearestIndex = 0;
+        int nearestCost = INT_MAX;
+        for (int i = 0; i < remaining.size(); ++i) {
+            int cost = distances.GetCost(greedyPath.back(), remaining[i]);
+            if (cost != -1 && cost < nearestCost) {
+                nearestCost = cost;
+                nearestIndex = i;
+            }
+        }
+        greedyPath.push_back(remaining[nearestIndex]);
+        swap(remaining[nearestIndex], remaining.back());
+        remaining.pop_back();
+    }
+
+    int greedyDistance = PathDistance(greedyPath, distances);
+    int currentDistance = PathDistance(path, distances);
+    if (greedyDistance != -1 && (currentDistance == -1 || greedyDistance < currentDistance)) {
+        path.swap(greedyPath);
+    }
+
+    // Keep applying improving moves until the path is locally optimal
+    for (int round = 0; round < MAX_LOCAL_SEARCH_ROUNDS; ++round) {
+        if (!TryTwoOpt(path, distances) && !TryOrOpt(path, distances)) {
+            break;
+        }
+    }
+}
+
+void OrderPath(vector<LocationID> &path, const DistanceMatrix &distances) {
+    if (path.empty()) {
+        PrintWarning("Warning: OrderPath received an empty path\n");
+        return;
+    }
+
+    if (path.size() - 1 <= HELD_KARP_MAX_STOPS) {
+        OrderPathHeldKarp(path, distances);
+    } else {
+        OrderPathLocalSearch(path, distances);
+    }
+}
+
+// Order a path in the shortest way in number of steps for each of the units
+void FindBestPathInPlan(vector<vector<LocationID> > &fullPlan, const DistanceMatrix &distances, ThreadPool &pool,
+                        TaskPriority priority) {
+    if (distances.size == 0) {
+        PrintError("Error: FindBestPathInPlan received an empty distance matrix\n");
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (int u = 0; u < fullPlan.size(); ++u) {
+        // Paths with less than 2 stations have only one order
+        if (fullPlan[u].size() > 2) {
+            group.Run([u, &fullPlan, &distances]() {
+                OrderPath(fullPlan[u], distances);
+            }, priority);
+        }
+    }
+
+    // Wait for all the units to be ordered
+    group.Wait();
+}
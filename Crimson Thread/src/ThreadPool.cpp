@@ -1,90 +1,635 @@
 #include "include/ThreadPool.h"
+#include "include/CpuTopology.h"
 #include "include/Visualizer.h"
 
-ThreadPool::ThreadPool(unsigned int num_threads)
+// Config for the shared pool, fixed once the pool is made
+static PoolConfig shared_config;
+static std::atomic<bool> shared_pool_made{false};
+
+thread_local ThreadPool *ThreadPool::current_pool_ = nullptr;
+thread_local unsigned int ThreadPool::current_index_ = 0;
+thread_local unsigned int ThreadPool::random_state_ = 1;
+thread_local int ThreadPool::high_streak_ = 0;
+thread_local int64_t ThreadPool::take_time_ = 0;
+
+ThreadPool::ThreadPool(unsigned int num_threads, PoolScheduler scheduler) : scheduler_(scheduler)
 {
-    if (num_threads > std::thread::hardware_concurrency() + 3) {
-        PrintWarning("Warning: constructed ThreadPoll with higher thread amount then CPU core.");
-    }
+    Start(num_threads);
+}
 
-    // Creat all the recuested threads
-    for (int i = 0; i < num_threads; ++i) {
-        threads_.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
+ThreadPool::ThreadPool(const PoolConfig &config) : scheduler_(config.scheduler)
+{
+    // Cores the threads may use, the reserved core stays free for the render/console thread
+    std::vector<int> cores = GetUsableCores(config.skip_smt_siblings);
+    cores.erase(std::remove(cores.begin(), cores.end(), config.reserved_core), cores.end());
+
+    unsigned int num_threads = config.num_threads;
+    if (num_threads == 0) {
+        num_threads = cores.empty() ? std::max(1u, std::thread::hardware_concurrency())
+                                    : static_cast<unsigned int>(cores.size());
+    }
 
-                    // Waiting for task or for distractor
-                    cv_.wait(lock, [this] {
-                        return !tasks_.empty() || stop_;
-                    });
+    if (config.pin_threads) {
+        if (cores.empty()) {
+            PrintWarning("Warning: ThreadPool found no cores to pin its threads to, they won't be pinned\n");
+        } else {
+            for (unsigned int i = 0; i < num_threads; ++i) {
+                thread_cores_.push_back(cores[i % cores.size()]);
+            }
+        }
+    }
 
-                    // stop the loop if there are no tasks and the pool is being distracted
-                    if (stop_ && tasks_.empty()) {
-                        return;
-                    }
+    Start(num_threads);
 
-                    // Get the next task from the queue
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-                // Other threads will be abel to use the queue will task() is running
-                task();
+    if (config.telemetry_dump_milliseconds > 0) {
+        FILE *file = stderr;
+        if (!config.telemetry_file.empty()) {
+            file = fopen(config.telemetry_file.c_str(), "a");
+            if (file == nullptr) {
+                PrintWarning("Warning: ThreadPool couldn't open %s, the telemetry goes to stderr\n",
+                             config.telemetry_file.c_str());
+                file = stderr;
             }
+        }
+        dump_thread_ = std::thread([this, file, config] {
+            DumpLoop(std::chrono::milliseconds(config.telemetry_dump_milliseconds), file);
         });
     }
 }
 
+void ThreadPool::Start(unsigned int num_threads)
+{
+    for (int p = 0; p < NUM_OF_TASK_PRIORITIES; ++p) {
+        shared_tasks_[p].store(0);
+    }
+
+    if (num_threads > std::thread::hardware_concurrency() + 3) {
+        PrintWarning("Warning: constructed ThreadPoll with higher thread amount then CPU core.");
+    }
+
+    // Every thread gets its deque before any thread starts, so thieves never see a missing one
+    if (scheduler_ == WORK_STEALING_SCHEDULER) {
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            deques_.emplace_back(new WorkStealingDeque<TaskNode *>());
+        }
+        free_nodes_.resize(num_threads);
+    }
+    if (scheduler_ == LOCK_FREE_QUEUE_SCHEDULER) {
+        for (int p = 0; p < NUM_OF_TASK_PRIORITIES; ++p) {
+            rings_[p].reset(new MpmcQueue<QueuedTask>(POOL_RING_CAPACITY));
+        }
+    }
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        counters_.emplace_back(new WorkerCounters());
+    }
+    start_time_ = Now();
+
+    // Creat all the recuested threads
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        threads_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+        if (i < thread_cores_.size() && !PinThreadToCore(threads_.back(), thread_cores_[i])) {
+            PrintWarning("Warning: ThreadPool couldn't pin thread %u to core %d\n", i, thread_cores_[i]);
+        }
+    }
+}
+
 ThreadPool::~ThreadPool()
 {
+    // The last dump still sees the threads
+    if (dump_thread_.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(dump_mutex_);
+            stop_dump_ = true;
+        }
+        dump_cv_.notify_all();
+        dump_thread_.join();
+    }
+
     {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
+        std::unique_lock<std::mutex> lock(wake_mutex_);
         stop_ = true;
     }
 
     // Wake up all threads
     cv_.notify_all();
+    event_count_.Notify(static_cast<int>(threads_.size()));
 
     // Joining all threads to make sure the system waits for them all
     for (auto& thread : threads_) {
         thread.join();
     }
+
+    for (std::vector<TaskNode *> &nodes : free_nodes_) {
+        for (TaskNode *node : nodes) {
+            delete node;
+        }
+    }
 }
 
-void ThreadPool::Enqueue(std::function<void()> task)
+void ThreadPool::WorkerLoop(unsigned int index)
 {
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        // Increment active tasks count
-        active_tasks_++;
-
-        // Wrap the task so calling it will also update the queue
-        auto wrapped_task = [this, task = std::move(task)]() {
-            // Call task
-            task();
-
-            // Decrement active tasks and notify if all tasks are done
-            int remaining;
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex_);
-                remaining = --active_tasks_;
+    current_pool_ = this;
+    current_index_ = index;
+    random_state_ = index * 2654435761u + 1;
+
+    WorkerCounters &counters = *counters_[index];
+    PoolTask task;
+    while (true) {
+        if (TryGetTask(index, task, random_state_)) {
+            // Only the tasks of this loop count as busy time, the ones a task runs while it waits are inside it
+            Increment(counters.busy_ns, RunTask(task));
+            continue;
+        }
+
+        // Nothing to do, sleep until a task is enqueued or the pool is being distracted
+        int64_t sleep_start = Now();
+        if (scheduler_ == LOCK_FREE_QUEUE_SCHEDULER) {
+            // Announce the wait before the last look, so an Enqueue after that look can't be missed
+            uint32_t key = event_count_.PrepareWait();
+            if (queued_tasks_.load() > 0 || stop_) {
+                event_count_.CancelWait();
+            } else {
+                event_count_.Wait(key);
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            sleeping_threads_.fetch_add(1);
+            cv_.wait(lock, [this] {
+                return queued_tasks_.load() > 0 || stop_;
+            });
+            sleeping_threads_.fetch_sub(1);
+        }
+        Increment(counters.idle_ns, Now() - sleep_start);
+
+        // stop the loop if there are no tasks and the pool is being distracted
+        if (stop_ && queued_tasks_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryGetTask(unsigned int index, PoolTask &task, unsigned int &random_state)
+{
+    // A steady flow of high priority tasks can't starve the low priority ones, every HIGH_PRIORITY_BURST
+    // high priority tasks in a row a waiting low priority task goes first
+    bool low_turn = high_streak_ >= HIGH_PRIORITY_BURST;
+    if (!low_turn && TakeSharedTask(HIGH_PRIORITY, task)) {
+        ++high_streak_;
+        return true;
+    }
+    if (TryGetLowPriorityTask(index, task, random_state)) {
+        high_streak_ = 0;
+        return true;
+    }
+    return low_turn && TakeSharedTask(HIGH_PRIORITY, task);
+}
+
+bool ThreadPool::TakeSharedTask(TaskPriority priority, PoolTask &task)
+{
+    // The locked queue only has tasks of the lock-free scheduler when the ring was full, they are older than most
+    // of the ring so they go first. The count may be stale, so an empty locked queue still looks at the ring.
+    if (shared_tasks_[priority].load(std::memory_order_relaxed) != 0) {
+        int64_t enqueue_time = 0;
+        bool taken = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!tasks_[priority].empty()) {
+                task = std::move(tasks_[priority].front().task);
+                enqueue_time = tasks_[priority].front().enqueue_time;
+                tasks_[priority].pop();
+                shared_tasks_[priority].fetch_sub(1, std::memory_order_relaxed);
+                taken = true;
             }
+        }
+        if (taken) {
+            CountTakenTask(priority, enqueue_time);
+            return true;
+        }
+    }
+
+    if (scheduler_ != LOCK_FREE_QUEUE_SCHEDULER) {
+        return false;
+    }
+    QueuedTask queued;
+    if (!rings_[priority]->TryPop(queued)) {
+        return false;
+    }
+    task = std::move(queued.task);
+    CountTakenTask(priority, queued.enqueue_time);
+    return true;
+}
+
+bool ThreadPool::TryGetLowPriorityTask(unsigned int index, PoolTask &task, unsigned int &random_state)
+{
+    // Newest task of this thread first, its data is most likely still in the cache
+    TaskNode *node;
+    if (scheduler_ == WORK_STEALING_SCHEDULER && deques_[index]->Pop(node)) {
+        int64_t enqueue_time = node->enqueue_time;
+        ReleaseNode(node, task);
+        CountTakenTask(LOW_PRIORITY, enqueue_time);
+        return true;
+    }
+
+    // Tasks from threads outside the pool
+    if (TakeSharedTask(LOW_PRIORITY, task)) {
+        return true;
+    }
 
-            // If this was the last task, notify
-            if (remaining == 0) {
-                tasks_done_cv_.notify_all();
+    // Steal the oldest task of another thread, starting from a random one so the thieves spread out
+    if (scheduler_ == WORK_STEALING_SCHEDULER) {
+        unsigned int num_threads = static_cast<unsigned int>(deques_.size());
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        unsigned int first = random_state % num_threads;
+        for (unsigned int k = 0; k < num_threads; ++k) {
+            unsigned int victim = (first + k) % num_threads;
+            if (victim != index && deques_[victim]->Steal(node)) {
+                int64_t enqueue_time = node->enqueue_time;
+                ReleaseNode(node, task);
+                CountTakenTask(LOW_PRIORITY, enqueue_time);
+                Increment(counters_[index]->steals);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+int64_t ThreadPool::RunTask(PoolTask &task)
+{
+    // Read before task(), a task that waits takes other tasks and moves take_time_
+    int64_t start = take_time_;
+
+    // Other threads will be abel to use the queue will task() is running
+    task();
+    task.Reset();
+    int64_t run_time = Now() - start;
+
+    // Counted before the task is done, so a WaitAll sees it
+    WorkerCounters &counters = *counters_[current_index_];
+    Increment(counters.tasks);
+    counters.run_time.Record(run_time);
+
+    // The last task to finish wakes the waiting threads, the lock makes sure they are waiting or will see the zero
+    if (active_tasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        {
+            std::unique_lock<std::mutex> lock(done_mutex_);
+        }
+        tasks_done_cv_.notify_all();
+    }
+    return run_time;
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    PoolTask task;
+    if (!TryGetTask(current_index_, task, random_state_)) {
+        return false;
+    }
+    RunTask(task);
+    return true;
+}
+
+ThreadPool::TaskNode *ThreadPool::AllocateNode(PoolTask &&task, int64_t enqueue_time)
+{
+    std::vector<TaskNode *> &nodes = free_nodes_[current_index_];
+    TaskNode *node;
+    if (nodes.empty()) {
+        node = new TaskNode();
+    } else {
+        node = nodes.back();
+        nodes.pop_back();
+    }
+    node->task = std::move(task);
+    node->enqueue_time = enqueue_time;
+    return node;
+}
+
+void ThreadPool::ReleaseNode(TaskNode *node, PoolTask &task)
+{
+    task = std::move(node->task);
+
+    // A thread that steals a lot gets the nodes of the others, don't let it hoard them
+    std::vector<TaskNode *> &nodes = free_nodes_[current_index_];
+    if (nodes.size() < MAX_FREE_TASK_NODES) {
+        nodes.push_back(node);
+    } else {
+        delete node;
+    }
+}
+
+void ThreadPool::WakeThreads(int count)
+{
+    if (scheduler_ == LOCK_FREE_QUEUE_SCHEDULER) {
+        event_count_.Notify(count);
+        return;
+    }
+
+    // Only pay for the wake up when a thread sleeps, the lock makes sure it already waits on cv_
+    int sleeping = sleeping_threads_.load();
+    if (sleeping == 0) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+    }
+    if (count >= sleeping) {
+        cv_.notify_all();
+    } else {
+        for (int i = 0; i < count; ++i) {
+            cv_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::Enqueue(PoolTask task, TaskPriority priority)
+{
+    // Count the task before anyone can take it, so the counters never go below zero
+    active_tasks_.fetch_add(1, std::memory_order_relaxed);
+    queued_tasks_.fetch_add(1);
+    int64_t enqueue_time = Now();
+
+    if (priority == LOW_PRIORITY && scheduler_ == WORK_STEALING_SCHEDULER && current_pool_ == this) {
+        // Enqueued by a task of this pool, keep it on this thread unless someone steals it
+        deques_[current_index_]->Push(AllocateNode(std::move(task), enqueue_time));
+    } else {
+        QueuedTask queued{std::move(task), enqueue_time};
+        if (scheduler_ != LOCK_FREE_QUEUE_SCHEDULER || !rings_[priority]->TryPush(queued)) {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            tasks_[priority].push(std::move(queued));
+            shared_tasks_[priority].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    WakeThreads(1);
+}
+
+void ThreadPool::EnqueueBulk(int begin, int end, std::function<void(int)> function, TaskPriority priority)
+{
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+
+    // All the tasks share one copy of the function, the last one to finish deletes it
+    struct BulkJob {
+        std::function<void(int)> function;
+        std::atomic<int> remaining;
+    };
+    BulkJob *job = new BulkJob{std::move(function), {count}};
+    auto make_task = [job](int index) {
+        return [job, index]() {
+            job->function(index);
+            if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete job;
             }
         };
+    };
+
+    active_tasks_.fetch_add(count, std::memory_order_relaxed);
+    queued_tasks_.fetch_add(count);
+    int64_t enqueue_time = Now();
 
-        tasks_.emplace(std::move(wrapped_task));
+    if (priority == LOW_PRIORITY && scheduler_ == WORK_STEALING_SCHEDULER && current_pool_ == this) {
+        WorkStealingDeque<TaskNode *> &deque = *deques_[current_index_];
+        for (int i = begin; i < end; ++i) {
+            deque.Push(AllocateNode(make_task(i), enqueue_time));
+        }
+    } else {
+        // Into the ring while it has room, the rest to the locked queue under one lock
+        int first = begin;
+        if (scheduler_ == LOCK_FREE_QUEUE_SCHEDULER) {
+            QueuedTask queued{PoolTask(), enqueue_time};
+            for (; first < end; ++first) {
+                queued.task = make_task(first);
+                if (!rings_[priority]->TryPush(queued)) {
+                    break;
+                }
+            }
+        }
+        if (first < end) {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            for (int i = first; i < end; ++i) {
+                tasks_[priority].push(QueuedTask{make_task(i), enqueue_time});
+            }
+            shared_tasks_[priority].fetch_add(end - first, std::memory_order_relaxed);
+        }
     }
-    cv_.notify_one();
+
+    WakeThreads(count);
 }
 
 void ThreadPool::WaitAll() {
-    std::unique_lock<std::mutex> lock(queue_mutex_);
+    std::unique_lock<std::mutex> lock(done_mutex_);
     tasks_done_cv_.wait(lock, [this]() {
-        return active_tasks_ == 0 && tasks_.empty();
+        return active_tasks_.load(std::memory_order_acquire) == 0;
     });
-}
\ No newline at end of file
+}
+
+int ThreadPool::ChunkSize(int count, int grain) const
+{
+    if (grain > 0) {
+        return grain;
+    }
+
+    // The calling thread works too, and a few chunks per thread even out chunks of different lengths
+    int num_chunks = (static_cast<int>(threads_.size()) + 1) * PARALLEL_CHUNKS_PER_THREAD;
+    return std::max(1, (count + num_chunks - 1) / num_chunks);
+}
+
+void ThreadPool::RunChunks(int num_chunks, const std::function<void(int)> &chunk, TaskPriority priority)
+{
+    if (num_chunks <= 1 || threads_.empty()) {
+        for (int c = 0; c < num_chunks; ++c) {
+            chunk(c);
+        }
+        return;
+    }
+
+    // Shared with the helper tasks, which may only start after the loop is over, so it can't live on the stack.
+    // chunk is only called for a taken chunk, and the caller waits for every taken chunk, so it never dangles.
+    struct ChunkState {
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        int count = 0;
+        const std::function<void(int)> *chunk = nullptr;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+    };
+    std::shared_ptr<ChunkState> state = std::make_shared<ChunkState>();
+    state->count = num_chunks;
+    state->chunk = &chunk;
+
+    auto take_chunks = [](ChunkState &shared) {
+        while (true) {
+            int c = shared.next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= shared.count) {
+                return;
+            }
+            (*shared.chunk)(c);
+
+            // The last chunk wakes the caller, the lock makes sure it waits or will see the count
+            if (shared.done.fetch_add(1, std::memory_order_acq_rel) + 1 == shared.count) {
+                {
+                    std::unique_lock<std::mutex> lock(shared.mutex);
+                }
+                shared.done_cv.notify_all();
+            }
+        }
+    };
+
+    int helpers = std::min(static_cast<int>(threads_.size()), num_chunks - 1);
+    EnqueueBulk(0, helpers, [state, take_chunks](int) {
+        take_chunks(*state);
+    }, priority);
+
+    // Help instead of blocking, then wait only for the chunks other threads are still running
+    take_chunks(*state);
+    if (current_pool_ == this) {
+        // Don't hold a pool thread idle, run other tasks until the chunks are done
+        while (state->done.load(std::memory_order_acquire) != state->count) {
+            if (!RunPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done_cv.wait(lock, [&state]() {
+        return state->done.load(std::memory_order_acquire) == state->count;
+    });
+}
+
+void ThreadPool::CountTakenTask(TaskPriority priority, int64_t enqueue_time)
+{
+    // The count before the take, the depth sample is what the task leaves behind
+    int queued = queued_tasks_.fetch_sub(1);
+    WorkerCounters &counters = *counters_[current_index_];
+    take_time_ = Now();
+    counters.queue_wait[priority].Record(take_time_ - enqueue_time);
+    counters.queue_depth.Record(queued - 1);
+}
+
+int64_t ThreadPool::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+QueueWaitStats ThreadPool::GetQueueWait(TaskPriority priority) const
+{
+    HistogramSnapshot wait;
+    for (const std::unique_ptr<WorkerCounters> &counters : counters_) {
+        wait.Merge(counters->queue_wait[priority].Snapshot());
+    }
+
+    QueueWaitStats stats;
+    stats.tasks = wait.total;
+    stats.mean_microseconds = wait.Mean() / 1e3;
+    stats.max_microseconds = wait.max / 1e3;
+    return stats;
+}
+
+PoolTelemetry ThreadPool::GetTelemetry() const
+{
+    PoolTelemetry telemetry;
+    telemetry.uptime_milliseconds = (Now() - start_time_) / 1e6;
+    telemetry.queued_tasks = queued_tasks_.load();
+    telemetry.active_tasks = active_tasks_.load();
+    telemetry.queue_wait.resize(NUM_OF_TASK_PRIORITIES);
+    for (int p = 0; p < NUM_OF_TASK_PRIORITIES; ++p) {
+        telemetry.shared_queue_depth.push_back(shared_tasks_[p].load(std::memory_order_relaxed));
+    }
+
+    for (unsigned int i = 0; i < counters_.size(); ++i) {
+        const WorkerCounters &counters = *counters_[i];
+        WorkerTelemetry worker;
+        worker.core = GetThreadCore(i);
+        worker.tasks = counters.tasks.load(std::memory_order_relaxed);
+        worker.steals = counters.steals.load(std::memory_order_relaxed);
+        worker.busy_milliseconds = counters.busy_ns.load(std::memory_order_relaxed) / 1e6;
+        worker.idle_milliseconds = counters.idle_ns.load(std::memory_order_relaxed) / 1e6;
+        telemetry.workers.push_back(worker);
+
+        for (int p = 0; p < NUM_OF_TASK_PRIORITIES; ++p) {
+            telemetry.queue_wait[p].Merge(counters.queue_wait[p].Snapshot());
+        }
+        telemetry.run_time.Merge(counters.run_time.Snapshot());
+        telemetry.queue_depth.Merge(counters.queue_depth.Snapshot());
+    }
+    return telemetry;
+}
+
+void ThreadPool::DumpLoop(std::chrono::milliseconds interval, FILE *file)
+{
+    std::unique_lock<std::mutex> lock(dump_mutex_);
+    while (!dump_cv_.wait_for(lock, interval, [this]() {
+        return stop_dump_;
+    })) {
+        PrintPoolTelemetry(GetTelemetry(), file);
+    }
+    PrintPoolTelemetry(GetTelemetry(), file);
+    if (file != stderr) {
+        fclose(file);
+    }
+}
+
+ThreadPool &ThreadPool::Shared()
+{
+    static ThreadPool pool([]() {
+        shared_pool_made.store(true);
+        return shared_config;
+    }());
+    return pool;
+}
+
+bool ThreadPool::ConfigureShared(const PoolConfig &config)
+{
+    if (shared_pool_made.load()) {
+        PrintWarning("Warning: ConfigureShared was called after the shared pool was made, the config is ignored\n");
+        return false;
+    }
+    shared_config = config;
+    return true;
+}
+
+void TaskGroup::Wait()
+{
+    if (ThreadPool::current_pool_ == &pool_) {
+        // Waiting on a pool thread, run tasks meanwhile so the tasks of the group can't be stuck behind this one
+        while (pending_.load(std::memory_order_acquire) > 0) {
+            if (!pool_.RunPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]() {
+            return pending_.load(std::memory_order_acquire) == 0;
+        });
+    }
+
+    // The last task may still be inside Done, its lock makes sure it left before the group can be destroyed
+    std::unique_lock<std::mutex> lock(mutex_);
+}
+
+void TaskGroup::Done()
+{
+    // Only the last task needs the lock, the others just count down
+    int pending = pending_.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (pending_.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        done_cv_.notify_all();
+    }
+}